@@ -0,0 +1,445 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * @brief Micro benchmarks for BadgerDB components.
+ *
+ * Usage: badgerdb_bench <benchmark> [options]
+ *
+ *   bufmgr [maxThreads]   readPage/unPinPage throughput of a shared, partitioned BufMgr for
+ *                         1, 2, 4, ... maxThreads threads; hit (working set fits in the pool)
+ *                         and miss (working set is four times the pool) variants.
+ *   policy                hit ratio of each replacement policy while a sequential scan over a
+ *                         file eight times the pool competes with skewed lookups on hot pages.
+ *   churn [numPages]      PageFile deletePage/allocatePage throughput on a relation of numPages
+ *                         pages, deleting pages at random positions in the used list.
+ *   scan [maxThreads]     ParallelFileScan throughput for 1, 2, 4, ... maxThreads workers, summing
+ *                         an attribute of every record; cold (pool a quarter of the relation) and
+ *                         warm (relation fits in the pool) variants.
+ *   lookup [numKeys]      BTreeIndex equality lookups of random keys on an INTEGER index over
+ *                         numKeys records: startScan/scanNext/endScan against lookup and contains.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "filescan.h"
+#include "btree.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::string benchFileName = "bench.pages";
+
+/**
+ * Remove a file left over by an earlier run, if any.
+ */
+void removeFile(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (FileNotFoundException &e)
+	{
+	}
+}
+
+/**
+ * Small xorshift generator so that threads do not share the state of rand().
+ */
+std::uint32_t nextRandom(std::uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+/**
+ * Run `threads` threads each doing `opsPerThread` random readPage/unPinPage pairs over the
+ * first `numPages` pages of the file, and return the throughput in operations per second.
+ */
+double runReadPage(BufMgr *bufMgr, File *file, std::uint32_t numPages, int threads, int opsPerThread)
+{
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread([=]() {
+			std::uint32_t state = 2463534242u + t * 7919;
+			Page *page;
+			for (int i = 0; i < opsPerThread; i++)
+			{
+				PageId pageNo = 1 + nextRandom(state) % numPages;
+				bufMgr->readPage(file, pageNo, page);
+				bufMgr->unPinPage(file, pageNo, false);
+			}
+		}));
+	}
+	for (std::size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return (double)threads * opsPerThread / elapsed.count();
+}
+
+void benchBufMgr(int maxThreads)
+{
+	const std::uint32_t poolSize = 1024;
+	const std::uint32_t partitions = 16;
+	const std::uint32_t filePages = 4 * poolSize;
+
+	removeFile(benchFileName);
+	{
+		BlobFile file(benchFileName, true);
+		BufMgr *bufMgr = new BufMgr(poolSize, partitions);
+		for (std::uint32_t i = 0; i < filePages; i++)
+		{
+			PageId pageNo;
+			Page *page;
+			bufMgr->allocPage(&file, pageNo, page);
+			bufMgr->unPinPage(&file, pageNo, true);
+		}
+		bufMgr->flushFile(&file);
+
+		std::cout << "readPage throughput, " << poolSize << " frames in " << partitions << " partitions\n";
+		std::cout << std::setw(8) << "threads" << std::setw(16) << "hit ops/s" << std::setw(16) << "miss ops/s" << "\n";
+		for (int threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			// warm the pool with half of its frames' worth of pages so every hit run finds them
+			runReadPage(bufMgr, &file, poolSize / 2, 1, poolSize * 4);
+			double hits = runReadPage(bufMgr, &file, poolSize / 2, threads, 1000000 / threads);
+			double misses = runReadPage(bufMgr, &file, filePages, threads, 100000 / threads);
+			std::cout << std::setw(8) << threads << std::setw(16) << (long)hits << std::setw(16) << (long)misses << "\n";
+		}
+
+		bufMgr->flushFile(&file);
+		delete bufMgr;
+	}
+	removeFile(benchFileName);
+}
+
+void benchPolicy()
+{
+	const std::uint32_t poolSize = 256;
+	const std::uint32_t hotPages = 128;
+	const std::uint32_t scanPages = 8 * poolSize;
+	const char *names[] = {"clock", "lru-k", "2q"};
+	const ReplacementPolicyType policies[] = {CLOCK_POLICY, LRU_K_POLICY, TWO_Q_POLICY};
+
+	removeFile(benchFileName);
+	{
+		BlobFile file(benchFileName, true);
+		{
+			BufMgr bufMgr(poolSize);
+			for (std::uint32_t i = 0; i < hotPages + scanPages; i++)
+			{
+				PageId pageNo;
+				Page *page;
+				bufMgr.allocPage(&file, pageNo, page);
+				bufMgr.unPinPage(&file, pageNo, true);
+			}
+			bufMgr.flushFile(&file);
+		}
+
+		std::cout << "hit ratio, " << poolSize << " frames, " << hotPages << " hot pages, scan of " << scanPages << " pages\n";
+		for (int p = 0; p < 3; p++)
+		{
+			BufMgr bufMgr(poolSize, 1, policies[p]);
+			std::uint32_t state = 2463534242u;
+			Page *page;
+			for (int round = 0; round < 4; round++)
+			{
+				for (PageId scanNo = hotPages + 1; scanNo <= hotPages + scanPages; scanNo++)
+				{
+					// two lookups per scanned page, skewed towards the first hot pages
+					for (int i = 0; i < 2; i++)
+					{
+						std::uint32_t r = nextRandom(state) % hotPages;
+						PageId hotNo = 1 + (r * r) / hotPages;
+						bufMgr.readPage(&file, hotNo, page);
+						bufMgr.unPinPage(&file, hotNo, false);
+					}
+					bufMgr.readPage(&file, scanNo, page);
+					bufMgr.unPinPage(&file, scanNo, false);
+				}
+			}
+			BufStats &stats = bufMgr.getBufStats();
+			std::cout << std::setw(8) << names[p] << std::setw(10) << std::fixed << std::setprecision(3)
+				<< stats.hitRatio() << "  (" << stats.hits << " hits, " << stats.misses << " misses)\n";
+			bufMgr.flushFile(&file);
+		}
+	}
+	removeFile(benchFileName);
+}
+
+void benchChurn(std::uint32_t numPages)
+{
+	const int ops = 20000;
+
+	removeFile(benchFileName);
+	{
+		PageFile file = PageFile::create(benchFileName);
+		std::vector<PageId> used;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (std::uint32_t i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+			used.push_back(pageNo);
+		}
+		std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - start;
+
+		std::uint32_t state = 2463534242u;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < ops; i++)
+		{
+			std::size_t victim = nextRandom(state) % used.size();
+			file.deletePage(used[victim]);
+			file.allocatePage(used[victim]);
+		}
+		std::chrono::duration<double> churnTime = std::chrono::steady_clock::now() - start;
+
+		std::cout << "page churn, " << numPages << " pages\n";
+		std::cout << std::setw(24) << "allocatePage (load)" << std::setw(16) << (long)(numPages / loadTime.count()) << " ops/s\n";
+		std::cout << std::setw(24) << "deletePage+allocatePage" << std::setw(16) << (long)(ops / churnTime.count()) << " ops/s\n";
+	}
+	removeFile(benchFileName);
+}
+
+/**
+ * Scan the relation with `threads` workers and return the throughput in records per second.
+ */
+double runParallelScan(BufMgr *bufMgr, int threads, long &sum)
+{
+	// one cache line per worker so that the workers do not share the line they update
+	struct WorkerTotals
+	{
+		long sum;
+		long count;
+		char pad[64 - 2 * sizeof(long)];
+	};
+	ParallelFileScan pscan(benchFileName, bufMgr, threads);
+	std::vector<WorkerTotals> totals(threads + 1);
+	WorkerTotals *aligned = reinterpret_cast<WorkerTotals*>(((std::uintptr_t)&totals[0] + 63) & ~(std::uintptr_t)63);
+	for (int t = 0; t < threads; t++)
+	{
+		aligned[t].sum = 0;
+		aligned[t].count = 0;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	pscan.scan([aligned](int worker, const RecordId &rid, const RecordView &record) {
+		int value;
+		memcpy(&value, record.data, sizeof(int));
+		aligned[worker].sum += value;
+		aligned[worker].count++;
+	});
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	long records = 0;
+	sum = 0;
+	for (int t = 0; t < threads; t++)
+	{
+		sum += aligned[t].sum;
+		records += aligned[t].count;
+	}
+	return records / elapsed.count();
+}
+
+void benchScan(int maxThreads)
+{
+	const std::uint32_t filePages = 8192;
+	const std::uint32_t partitions = 16;
+	const std::string record(100, 'x');
+
+	removeFile(benchFileName);
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (std::uint32_t i = 0; i < filePages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			int value = 0;
+			while (page.hasSpaceForRecord(record))
+			{
+				RecordId rid = page.insertRecord(record);
+				page.updateRecord(rid, std::string(reinterpret_cast<char*>(&value), sizeof(int)) + record.substr(sizeof(int)));
+				value++;
+			}
+			file.writePage(pageNo, page);
+		}
+	}
+
+	std::cout << "parallel scan throughput, " << filePages << " pages\n";
+	std::cout << std::setw(8) << "threads" << std::setw(16) << "cold rec/s" << std::setw(16) << "warm rec/s" << "\n";
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		long coldSum, warmSum;
+		BufMgr *small = new BufMgr(filePages / 4, partitions);
+		double cold = runParallelScan(small, threads, coldSum);
+		delete small;
+
+		BufMgr *large = new BufMgr(filePages + filePages / 4, partitions);
+		runParallelScan(large, threads, warmSum);
+		double warm = runParallelScan(large, threads, warmSum);
+		delete large;
+
+		if (coldSum != warmSum)
+		{
+			std::cout << "sums differ\n";
+		}
+		std::cout << std::setw(8) << threads << std::setw(16) << (long)cold << std::setw(16) << (long)warm << "\n";
+	}
+	removeFile(benchFileName);
+}
+
+void benchLookup(int numKeys)
+{
+	const int lookups = 200000;
+	const std::string record(100, 'x');
+	const std::string relation = "bench.rel";
+	std::string indexName;
+
+	removeFile(relation);
+	removeFile(relation + ".0");
+	{
+		PageFile file = PageFile::create(relation);
+		PageId pageNo;
+		Page page = file.allocatePage(pageNo);
+		for (int value = 0; value < numKeys; value++)
+		{
+			std::string data = std::string(reinterpret_cast<char*>(&value), sizeof(int)) + record.substr(sizeof(int));
+			if (!page.hasSpaceForRecord(data))
+			{
+				file.writePage(pageNo, page);
+				page = file.allocatePage(pageNo);
+			}
+			page.insertRecord(data);
+		}
+		file.writePage(pageNo, page);
+	}
+
+	{
+		BufMgr bufMgr(4096);
+		BTreeIndex index(relation, indexName, &bufMgr, 0, INTEGER);
+
+		std::cout << "equality lookups, " << numKeys << " INTEGER keys, " << lookups << " random lookups\n";
+		std::uint32_t state = 2463534242u;
+		long found = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++)
+		{
+			int key = nextRandom(state) % numKeys;
+			index.startScan(&key, GTE, &key, LTE);
+			try
+			{
+				RecordId rid;
+				while (1)
+				{
+					index.scanNext(rid);
+					found++;
+				}
+			}
+			catch (IndexScanCompletedException &e)
+			{
+			}
+			index.endScan();
+		}
+		std::chrono::duration<double> scanTime = std::chrono::steady_clock::now() - start;
+
+		state = 2463534242u;
+		std::vector<RecordId> rids;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++)
+		{
+			int key = nextRandom(state) % numKeys;
+			found -= index.lookup(&key, rids);
+		}
+		std::chrono::duration<double> lookupTime = std::chrono::steady_clock::now() - start;
+
+		state = 2463534242u;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++)
+		{
+			int key = nextRandom(state) % numKeys;
+			found -= index.contains(&key) ? 0 : 1;
+		}
+		std::chrono::duration<double> containsTime = std::chrono::steady_clock::now() - start;
+
+		if (found != 0)
+		{
+			std::cout << "results differ\n";
+		}
+		std::cout << std::setw(24) << "startScan/scanNext" << std::setw(16) << (long)(lookups / scanTime.count()) << " ops/s\n";
+		std::cout << std::setw(24) << "lookup" << std::setw(16) << (long)(lookups / lookupTime.count()) << " ops/s\n";
+		std::cout << std::setw(24) << "contains" << std::setw(16) << (long)(lookups / containsTime.count()) << " ops/s\n";
+	}
+	removeFile(relation);
+	removeFile(relation + ".0");
+}
+
+void usage()
+{
+	std::cout << "usage: badgerdb_bench bufmgr [maxThreads]\n";
+	std::cout << "       badgerdb_bench policy\n";
+	std::cout << "       badgerdb_bench churn [numPages]\n";
+	std::cout << "       badgerdb_bench scan [maxThreads]\n";
+	std::cout << "       badgerdb_bench lookup [numKeys]\n";
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+
+	std::string benchmark = argv[1];
+	if (benchmark == "bufmgr")
+	{
+		int maxThreads = argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+		benchBufMgr(maxThreads);
+	}
+	else if (benchmark == "policy")
+	{
+		benchPolicy();
+	}
+	else if (benchmark == "churn")
+	{
+		benchChurn(argc > 2 ? atoi(argv[2]) : 16384);
+	}
+	else if (benchmark == "scan")
+	{
+		int maxThreads = argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+		benchScan(maxThreads);
+	}
+	else if (benchmark == "lookup")
+	{
+		benchLookup(argc > 2 ? atoi(argv[2]) : 100000);
+	}
+	else
+	{
+		usage();
+		return 1;
+	}
+	return 0;
+}
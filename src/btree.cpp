@@ -6,10 +6,12 @@
  */
 
 #include "btree.h"
+#include "external_sort.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
@@ -19,6 +21,7 @@
 #include "exceptions/insufficient_space_exception.h"
 #include <vector>
 #include <algorithm>
+#include <cstddef>
 
 //#define DEBUG
 using std::cout;
@@ -26,12 +29,60 @@ using std::endl;
 namespace badgerdb
 {
 
-typedef struct tuple
+// -----------------------------------------------------------------------------
+// Node search helpers
+// -----------------------------------------------------------------------------
+
+// position of the child of a non-leaf node to descend into for the key: after every key <= it
+template <class Traits>
+static int childIndex(const typename Traits::NonLeafNode *node, const typename Traits::KeyType &key)
+{
+	return Traits::upperBound(node->keyArray, node->size, key);
+}
+
+// position of the first key satisfying the low end of a scan (lowOp is GT or GTE)
+template <class Traits>
+static int lowBoundIndex(const typename Traits::NodeKey *keys, int size, const typename Traits::KeyType &lowVal, const Operator lowOp)
+{
+	return lowOp == GTE ? Traits::lowerBound(keys, size, lowVal) : Traits::upperBound(keys, size, lowVal);
+}
+
+// the scan bounds live in one pair of members per key type
+template <>
+int &IndexCursor::scanLowVal<IntKeyTraits>()
+{
+	return lowValInt;
+}
+
+template <>
+int &IndexCursor::scanHighVal<IntKeyTraits>()
+{
+	return highValInt;
+}
+
+template <>
+double &IndexCursor::scanLowVal<DoubleKeyTraits>()
+{
+	return lowValDouble;
+}
+
+template <>
+double &IndexCursor::scanHighVal<DoubleKeyTraits>()
+{
+	return highValDouble;
+}
+
+template <>
+std::string &IndexCursor::scanLowVal<StringKeyTraits>()
+{
+	return lowValString;
+}
+
+template <>
+std::string &IndexCursor::scanHighVal<StringKeyTraits>()
 {
-	int i;
-	double d;
-	char s[64];
-} RECORD;
+	return highValString;
+}
 
 const void BTreeIndex::InitializeBTreeIndex(BufMgr *bufMgrIn, 
 									  		const int attrByteOffset,
@@ -42,134 +93,307 @@ const void BTreeIndex::InitializeBTreeIndex(BufMgr *bufMgrIn,
 	BTreeIndex::attrByteOffset = attrByteOffset;
 	if (attrType == INTEGER)
 	{
-		BTreeIndex::leafOccupancy = INTARRAYLEAFSIZE;
-		BTreeIndex::nodeOccupancy = INTARRAYNONLEAFSIZE;
+		BTreeIndex::leafOccupancy = IntKeyTraits::LEAF_SIZE;
+		BTreeIndex::nodeOccupancy = IntKeyTraits::NONLEAF_SIZE;
 	}
 	else if (attrType == DOUBLE)
 	{
-		BTreeIndex::leafOccupancy = DOUBLEARRAYLEAFSIZE;
-		BTreeIndex::nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
+		BTreeIndex::leafOccupancy = DoubleKeyTraits::LEAF_SIZE;
+		BTreeIndex::nodeOccupancy = DoubleKeyTraits::NONLEAF_SIZE;
 	}
 	else if (attrType == STRING)
 	{
-		BTreeIndex::leafOccupancy = STRINGARRAYLEAFSIZE;
-		BTreeIndex::nodeOccupancy = STRINGARRAYNONLEAFSIZE;
+		BTreeIndex::leafOccupancy = StringKeyTraits::LEAF_SIZE;
+		BTreeIndex::nodeOccupancy = StringKeyTraits::NONLEAF_SIZE;
 	}
 	else
 	{
 		std::cout << "ERROR! UnSupported TYPE, we only support int, double and string";
 		throw ScanNotInitializedException();
 	}
-	BTreeIndex::scanExecuting = false;
+	BTreeIndex::scanCursor = NULL;
 	BTreeIndex::headerPageNum = 1;
-	BTreeIndex::fullTime = 0;
+	setIncludeColumns(std::vector<IncludeColumn>());
+}
+
+void BTreeIndex::setIncludeColumns(const std::vector<IncludeColumn> &columns)
+{
+	if (columns.size() > (std::size_t)MAX_INCLUDE_COLUMNS)
+	{
+		throw BadIndexInfoException("too many include columns");
+	}
+	int width = 0;
+	for (std::size_t i = 0; i < columns.size(); i++)
+	{
+		if (columns[i].offset < 0 || columns[i].width <= 0)
+		{
+			throw BadIndexInfoException("include column needs an offset and a positive width");
+		}
+		width += columns[i].width;
+	}
+	includeColumns = columns;
+	includeWidth = width;
+
+	if (attributeType == INTEGER)
+	{
+		layOutLeaves<IntKeyTraits>();
+	}
+	else if (attributeType == DOUBLE)
+	{
+		layOutLeaves<DoubleKeyTraits>();
+	}
+	else
+	{
+		layOutLeaves<StringKeyTraits>();
+	}
+}
+
+template <class Traits>
+void BTreeIndex::layOutLeaves()
+{
+	typedef typename Traits::LeafNode LeafType;
+	if (includeWidth == 0)
+	{
+		leafOccupancy = Traits::LEAF_SIZE;
+		leafRidOffset = offsetof(LeafType, ridArray);
+		leafIncludeOffset = offsetof(LeafType, rightSibPageNo);
+		return;
+	}
+
+	// the keys stay where the leaf struct has them, so leaves are searched the same way; the rids
+	// and the INCLUDE columns share the rest of the page up to rightSibPageNo
+	const std::size_t keysOffset = offsetof(LeafType, keyArray);
+	const std::size_t end = offsetof(LeafType, rightSibPageNo);
+	const std::size_t ridAlign = alignof(RecordId);
+	int capacity = (end - keysOffset) / (sizeof(typename Traits::NodeKey) + sizeof(RecordId) + includeWidth);
+	for (; capacity > 0; capacity--)
+	{
+		std::size_t ridOffset = (keysOffset + capacity * sizeof(typename Traits::NodeKey) + ridAlign - 1) / ridAlign * ridAlign;
+		if (ridOffset + capacity * (sizeof(RecordId) + includeWidth) <= end)
+		{
+			leafRidOffset = ridOffset;
+			leafIncludeOffset = ridOffset + capacity * sizeof(RecordId);
+			break;
+		}
+	}
+	// a split needs room for two entries
+	if (capacity < 2)
+	{
+		throw BadIndexInfoException("include columns do not fit in a leaf");
+	}
+	leafOccupancy = capacity;
+}
+
+template <class Traits>
+RecordId *BTreeIndex::leafRids(typename Traits::LeafNode *leafNode)
+{
+	return reinterpret_cast<RecordId *>(reinterpret_cast<char *>(leafNode) + leafRidOffset);
+}
+
+char *BTreeIndex::leafIncludes(void *leafNode, int position)
+{
+	return reinterpret_cast<char *>(leafNode) + leafIncludeOffset + (std::size_t)position * includeWidth;
+}
+
+void BTreeIndex::extractIncludes(const char *record, std::size_t length, char *dst)
+{
+	for (std::size_t i = 0; i < includeColumns.size(); i++)
+	{
+		const IncludeColumn &column = includeColumns[i];
+		std::size_t available = (std::size_t)column.offset < length ? length - column.offset : 0;
+		std::size_t copied = std::min(available, (std::size_t)column.width);
+		memcpy(dst, record + column.offset, copied);
+		memset(dst + copied, 0, column.width - copied);
+		dst += column.width;
+	}
+}
+
+template <class Traits>
+void BTreeIndex::storeLeafEntry(typename Traits::LeafNode *leafNode, int position, const RecordId rid, const char *includes)
+{
+	leafRids<Traits>(leafNode)[position] = rid;
+	if (includeWidth > 0)
+	{
+		memcpy(leafIncludes(leafNode, position), includes, includeWidth);
+	}
+}
+
+int BTreeIndex::getIncludeWidth() const
+{
+	return includeWidth;
 }
 
-template <class T>
+template <class Traits>
 void BTreeIndex::buildBTree(const std::string &relationName,
 							IndexMetaInfo &BTreeMetaData)
 {
-	// allocate a root page and a header page on BTreeDataFile
-	Page* headerPage;
-	Page* rootPage;
+	typedef typename Traits::KeyType T;
 
+	// allocate the header page first so that it always gets page number 1
+	Page* headerPage;
 	bufMgr->allocPage(file, headerPageNum, headerPage);
-	bufMgr->allocPage(file, rootPageNum, rootPage);
+	bufMgr->unPinPage(file, headerPageNum, true);
+
+	// scan the file and sort every <key, rid> pair of the relation
+	// the INCLUDE columns of each entry travel through the sort with it
+	ExternalSorter<T> ridKeys(bufMgr, file->filename(), sortMemoryBudget, includeWidth);
+	std::string includes(includeWidth, '\0');
+	{
+		FileScan fscan(relationName, bufMgr);
+		RecordId scanRids[SCAN_BATCH_SIZE];
+		RecordView records[SCAN_BATCH_SIZE];
+		int count;
+		while ((count = fscan.scanNextBatch(scanRids, records, SCAN_BATCH_SIZE)) > 0)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				// get the index key straight from the record in the buffer pool
+				RIDKeyPair<T> ridKey;
+				ridKey.rid = scanRids[i];
+				Traits::extract(records[i].data + attrByteOffset, records[i].length - attrByteOffset, ridKey.key);
+				extractIncludes(records[i].data, records[i].length, &includes[0]);
+				ridKeys.add(ridKey, includes.data());
+			}
+		}
+	}
+
+	ridKeys.finish();
+	bulkLoad<Traits>(ridKeys, BTreeMetaData);
+}
+
+template <class Traits>
+void BTreeIndex::bulkLoad(ExternalSorter<typename Traits::KeyType> &entries, IndexMetaInfo &BTreeMetaData)
+{
+	typedef typename Traits::KeyType T;
+	typedef typename Traits::LeafNode LeafType;
+
+	// number of entries packed into each leaf
+	int leafFill = std::max(1, std::min(leafOccupancy, (int)(fillFactor * leafOccupancy)));
+
+	// page number and smallest key of every leaf, left to right
+	std::vector<PageKeyPair<T>> level;
+
+	PageId leafPageId;
+	Page* leafPage;
+	bufMgr->allocPage(file, leafPageId, leafPage);
+	LeafType* leafNode = reinterpret_cast<LeafType*>(leafPage);
+	leafNode->size = 0;
+	leafNode->rightSibPageNo = Page::INVALID_NUMBER;
+	PageKeyPair<T> leafEntry;
+	leafEntry.pageNo = leafPageId;
+	level.push_back(leafEntry);
+
+	RIDKeyPair<T> entry;
+	std::string includes(includeWidth, '\0');
+	while (entries.next(entry, &includes[0]))
+	{
+		if (leafNode->size == leafFill)
+		{
+			// current leaf is filled, chain a new one to its right
+			PageId nextLeafPageId;
+			Page* nextLeafPage;
+			bufMgr->allocPage(file, nextLeafPageId, nextLeafPage);
+			leafNode->rightSibPageNo = nextLeafPageId;
+			bufMgr->unPinPage(file, leafPageId, true);
+
+			leafPageId = nextLeafPageId;
+			leafNode = reinterpret_cast<LeafType*>(nextLeafPage);
+			leafNode->size = 0;
+			leafNode->rightSibPageNo = Page::INVALID_NUMBER;
+			leafEntry.pageNo = leafPageId;
+			level.push_back(leafEntry);
+		}
+		if (leafNode->size == 0)
+		{
+			level.back().key = entry.key;
+		}
+		Traits::store(leafNode->keyArray[leafNode->size], entry.key);
+		storeLeafEntry<Traits>(leafNode, leafNode->size, entry.rid, includes.data());
+		leafNode->size++;
+	}
+	// the last leaf ends the chain
+	leafNode->rightSibPageNo = Page::INVALID_NUMBER;
+	bufMgr->unPinPage(file, leafPageId, true);
 
-	// initalize the size of the root to zeros
-	if (attributeType == INTEGER) {
-		((LeafNodeInt*) rootPage)->size = 0;
-	} else if (attributeType == DOUBLE) {
-		((LeafNodeDouble*) rootPage)->size = 0;
-	} else {
-		((LeafNodeString*) rootPage)->size = 0;
+	// build the non-leaf levels until only the root is left
+	int nodeLevel = 1;
+	while (level.size() > 1)
+	{
+		level = bulkLoadNonLeafLevel<Traits>(level, nodeLevel);
+		nodeLevel = 0;
 	}
 
-	// save it in the metadata file
+	rootPageNum = level[0].pageNo;
 	BTreeMetaData.rootPageNo = rootPageNum;
-	BTreeMetaData.isLeafPage = true;
+	BTreeMetaData.isLeafPage = (nodeLevel == 1);
 
 	// copy the metadata into header page
+	Page* headerPage;
+	bufMgr->readPage(file, headerPageNum, headerPage);
 	memcpy(headerPage, &BTreeMetaData, sizeof(IndexMetaInfo));
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
 
-	// scan the file and insert key RID into vector
-	std::vector<RIDKeyPair<int>> intRidKey;
-	std::vector<RIDKeyPair<double>> doubleRidKey;
-	std::vector<RIDKeyPair<std::string>> stringRidKey;
-	FileScan fscan(relationName, bufMgr);
-	try
+template <class Traits>
+std::vector<PageKeyPair<typename Traits::KeyType>> BTreeIndex::bulkLoadNonLeafLevel(const std::vector<PageKeyPair<typename Traits::KeyType>> &children, int level)
+{
+	typedef typename Traits::KeyType T;
+	typedef typename Traits::NonLeafNode NonLeafType;
+
+	// number of children packed into each non-leaf node
+	int maxChildren = nodeOccupancy + 1;
+	int nodeFill = std::max(2, std::min(maxChildren, (int)(fillFactor * maxChildren)));
+
+	// split the children into groups of nodeFill, never leaving a node with a single child
+	std::vector<int> groupSizes;
+	int remaining = children.size();
+	while (remaining > 0)
 	{
-		while (1) {
-			RecordId scanRid;
-			try
-			{
-				while (1)
-				{
-					fscan.scanNext(scanRid);
-
-					std::string recordStr = fscan.getRecord();
-
-					// get the index key from record
-					const char *record = recordStr.c_str();
-					if (BTreeMetaData.attrType == INTEGER)
-					{
-						int key = *((int *)(record + offsetof(RECORD, i)));
-						RIDKeyPair<int> RidKey;
-						RidKey.set(scanRid, key);
-						intRidKey.push_back(RidKey);
-					}
-					else if (BTreeMetaData.attrType == DOUBLE)
-					{
-						double key = *((double *)(record + offsetof(RECORD, d)));
-						RIDKeyPair<double> RidKey;
-						RidKey.set(scanRid, key);
-						doubleRidKey.push_back(RidKey);
-					}
-					else if (BTreeMetaData.attrType == STRING)
-					{
-						std::string key = (record + offsetof(RECORD, s));
-						RIDKeyPair<std::string> RidKey;
-						RidKey.set(scanRid, key);
-						stringRidKey.push_back(RidKey);
-					}
-				}
-			}
-			catch (InsufficientSpaceException &e)
-			{
-			}
-		}
+		int groupSize = std::min(nodeFill, remaining);
+		groupSizes.push_back(groupSize);
+		remaining -= groupSize;
 	}
-	catch (EndOfFileException e)
+	if (groupSizes.size() > 1 && groupSizes.back() == 1)
 	{
-		if (BTreeIndex::attributeType == INTEGER)
-		{
-			std::sort(intRidKey.begin(), intRidKey.end(), [](RIDKeyPair<int> i, RIDKeyPair<int> j){return i.key < j.key;});
-			for (RIDKeyPair<int> i: intRidKey)
-			{
-				insertEntry(&i.key, i.rid);
-			}
-		} else if (BTreeIndex::attributeType == DOUBLE)
+		if (groupSizes[groupSizes.size() - 2] < maxChildren)
 		{
-			std::sort(doubleRidKey.begin(), doubleRidKey.end(), [](RIDKeyPair<double> i, RIDKeyPair<double> j){return i.key < j.key;});
-			for (RIDKeyPair<double> i: doubleRidKey)
-			{
-				insertEntry(&i.key, i.rid);
-			}
-		} else 
+			groupSizes.pop_back();
+			groupSizes.back()++;
+		}
+		else
 		{
-			std::sort(stringRidKey.begin(), stringRidKey.end(), [](RIDKeyPair<std::string> i, RIDKeyPair<std::string> j){return i.key < j.key;});
-			for (RIDKeyPair<std::string> i: stringRidKey)
-			{
-				insertEntry(&i.key, i.rid);
-			}
+			groupSizes[groupSizes.size() - 2]--;
+			groupSizes.back()++;
 		}
-		std::cout << "Read all records" << std::endl;
-		// data is written into it, set dirty bit to true
-		bufMgr->unPinPage(file, headerPageNum, true);
-		bufMgr->unPinPage(file, 2, true);
 	}
 
-	// BTreeDataFile->writePage(BTreeID, new_page);
+	std::vector<PageKeyPair<T>> parents;
+	int child = 0;
+	for (std::vector<int>::iterator it = groupSizes.begin(); it != groupSizes.end(); ++it)
+	{
+		PageId nonLeafPageId;
+		Page* nonLeafPage;
+		bufMgr->allocPage(file, nonLeafPageId, nonLeafPage);
+		NonLeafType* nonLeafNode = reinterpret_cast<NonLeafType*>(nonLeafPage);
+		nonLeafNode->level = level;
+		nonLeafNode->size = *it - 1;
+
+		// the key left of pageNoArray[i] is the smallest key reachable through it
+		nonLeafNode->pageNoArray[0] = children[child].pageNo;
+		for (int i = 1; i < *it; i++)
+		{
+			Traits::store(nonLeafNode->keyArray[i - 1], children[child + i].key);
+			nonLeafNode->pageNoArray[i] = children[child + i].pageNo;
+		}
+		bufMgr->unPinPage(file, nonLeafPageId, true);
+
+		PageKeyPair<T> parent;
+		parent.pageNo = nonLeafPageId;
+		parent.key = children[child].key;
+		parents.push_back(parent);
+		child += *it;
+	}
+	return parents;
 }
 
 // -----------------------------------------------------------------------------
@@ -180,10 +404,19 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const BTreeBuildOptions &options)
 {
 	// initialize the variable in struct
 	InitializeBTreeIndex(bufMgrIn, attrByteOffset, attrType);
+	if (options.fillFactor <= 0 || options.fillFactor > 1)
+	{
+		throw BadIndexInfoException("fill factor must be in (0, 1]");
+	}
+	fillFactor = options.fillFactor;
+	sortMemoryBudget = options.sortMemoryBudget;
+	prefetchWindow = DEFAULT_PREFETCH_WINDOW;
+	setIncludeColumns(options.includeColumns);
 
 	// first construct the indexfile by concatenating the relation name with the offset of the attribute over which the index is built
 	std::ostringstream idxStr;
@@ -194,9 +427,7 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 
 	// create a B+ Tree BlobFile to store the index
 	// if a B+ Tree with the indexName already been created, catch a FileExistsException
-	BlobFile* BTreeDataFile;
 	Page* headerPage;
-	Page* rootPage;
 	try {
 		file = new BlobFile(indexName, true);
 	}
@@ -211,26 +442,58 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		IndexMetaInfo* metaDataInfo = (IndexMetaInfo*) headerPage;
 
 		rootPageNum = metaDataInfo->rootPageNo;
+		const int includeCount = metaDataInfo->includeCount;
+		std::vector<IncludeColumn> columns;
+		if (includeCount >= 0 && includeCount <= MAX_INCLUDE_COLUMNS)
+		{
+			columns.assign(metaDataInfo->includeColumns, metaDataInfo->includeColumns + includeCount);
+		}
 
 		bufMgr->unPinPage(file, headerPageNum, false);
 
+		try
+		{
+			if (includeCount < 0 || includeCount > MAX_INCLUDE_COLUMNS)
+			{
+				throw BadIndexInfoException("bad include column count in the meta page");
+			}
+			if (!options.includeColumns.empty() && options.includeColumns != columns)
+			{
+				throw BadIndexInfoException("include columns differ from the ones the index was built with");
+			}
+
+			// the leaves were laid out for the columns the index was built with
+			setIncludeColumns(columns);
+		}
+		catch (const BadIndexInfoException &)
+		{
+			// the destructor does not run for a constructor that throws
+			bufMgr->flushFile(file);
+			delete file;
+			file = NULL;
+			throw;
+		}
+
 		return;
 	}
 
 	// copy metadata information
 	IndexMetaInfo BTreeMetaData;
+	memset(&BTreeMetaData, 0, sizeof(IndexMetaInfo));
 	memcpy(BTreeMetaData.relationName, relationName.c_str(), STRINGSIZE);
 	BTreeMetaData.attrByteOffset = attrByteOffset;
 	BTreeMetaData.attrType = attrType;
+	BTreeMetaData.includeCount = includeColumns.size();
+	std::copy(includeColumns.begin(), includeColumns.end(), BTreeMetaData.includeColumns);
 
 	// Get Records from relation file: use FileScan Class
 	// plus build a BTree
 	if (attrType == INTEGER) {
-		buildBTree<int>(relationName, BTreeMetaData);
+		buildBTree<IntKeyTraits>(relationName, BTreeMetaData);
 	} else if (attrType == DOUBLE) {
-		buildBTree<double>(relationName, BTreeMetaData);
+		buildBTree<DoubleKeyTraits>(relationName, BTreeMetaData);
 	} else if (attrType == STRING) {
-		buildBTree<std::string>(relationName, BTreeMetaData);
+		buildBTree<StringKeyTraits>(relationName, BTreeMetaData);
 	}
 
 }
@@ -242,8 +505,10 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 
 BTreeIndex::~BTreeIndex()
 {
+	// end the scan run through startScan so that its leaf is unpinned
+	delete scanCursor;
+	scanCursor = NULL;
 	bufMgr->flushFile(file);
-	BTreeIndex::scanExecuting = false;
 	// try {
 	// 	bufMgr->flushFile(file);
 	// }
@@ -259,673 +524,368 @@ BTreeIndex::~BTreeIndex()
 // -----------------------------------------------------------------------------
 // BTreeIndex::insertEntry
 // -----------------------------------------------------------------------------
-void BTreeIndex::insertDataLeaf(PageId pageId, int position, const void *key)
+const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
 {
-	Page* leafPage;
-	bufMgr->readPage(file, pageId, leafPage);
+	if (includeWidth > 0)
+	{
+		throw BadIndexInfoException("a covering index needs the record of every entry");
+	}
+	insertEntry(key, rid, std::string());
+}
+
+const void BTreeIndex::insertEntry(const void *key, const RecordId rid, const std::string &record)
+{
+	std::string includes(includeWidth, '\0');
+	extractIncludes(record.data(), record.size(), &includes[0]);
+	const char *entryIncludes = includeWidth > 0 ? includes.data() : NULL;
 	if (attributeType == INTEGER) 
 	{
-		LeafNodeInt* leafNode = reinterpret_cast<LeafNodeInt*>(leafPage);
-		leafNode->keyArray[position] = *(int*) key;
+		insertKey<IntKeyTraits>(IntKeyTraits::fromInsertParam(key), rid, entryIncludes);
 	} else if (attributeType == DOUBLE) 
 	{
-		LeafNodeDouble* leafNode = reinterpret_cast<LeafNodeDouble*>(leafPage);
-		leafNode->keyArray[position] = *(double*) key;
+		insertKey<DoubleKeyTraits>(DoubleKeyTraits::fromInsertParam(key), rid, entryIncludes);
 	} else 
 	{
-		LeafNodeString* leafNode = reinterpret_cast<LeafNodeString*>(leafPage);
-		for (int i = 0; i < STRINGSIZE; i++)
-		{
-			leafNode->keyArray[position][i] = (*(std::string *)key)[i];
-		}
+		insertKey<StringKeyTraits>(StringKeyTraits::fromInsertParam(key), rid, entryIncludes);
 	}
-	bufMgr->unPinPage(file, pageId, true);
 }
 
-void BTreeIndex::insertDataNonLeaf(PageId pageId, int position, const void *key)
+template <class Traits>
+void BTreeIndex::insertKey(const typename Traits::KeyType &key, const RecordId rid, const char *includes)
 {
-	Page *nonLeafPage;
-	bufMgr->readPage(file, pageId, nonLeafPage);
-	if (attributeType == INTEGER)
-	{
-		NonLeafNodeInt *nonLeafNode = reinterpret_cast<NonLeafNodeInt *>(nonLeafPage);
-		nonLeafNode->keyArray[position] = *(int*) key;
-		std::cout << "non leaf key: " << nonLeafNode->keyArray[position] << " position: " << position << std::endl;
-	}
-	else if (attributeType == DOUBLE)
+	// keys arriving in ascending order go straight to the rightmost leaf
+	if (appendKey<Traits>(key, rid, includes))
 	{
-		NonLeafNodeDouble *nonLeafNode = reinterpret_cast<NonLeafNodeDouble *>(nonLeafPage);
-		nonLeafNode->keyArray[position] = *(double *)key;
+		return;
 	}
-	else
+
+	// otherwise descend from the root; a split that reaches the root grows the tree by a level
+	typename Traits::KeyType splitKey;
+	PageId splitPageNum;
+	const bool split = isALeafPage()
+		? insertLeafEntry<Traits>(rootPageNum, key, rid, includes, splitKey, splitPageNum)
+		: traverseNode<Traits>(rootPageNum, key, rid, includes, splitKey, splitPageNum);
+	if (split)
 	{
-		NonLeafNodeString *nonLeafNode = reinterpret_cast<NonLeafNodeString *>(nonLeafPage);
-		for (int i = 0; i < STRINGSIZE; i++)
-		{
-			nonLeafNode->keyArray[position][i] = (*(std::string *)key)[i];
-		}
-		std::cout << "non leaf key: " << nonLeafNode->keyArray[position] << " position: " << position << std::endl;
+		growRoot<Traits>(splitKey, splitPageNum);
 	}
-	bufMgr->unPinPage(file, pageId, true);
 }
 
-template <class Type1, class Type2>
-void BTreeIndex::insertDataAnyTypeString(PageId pageId, int position, PageId keyPageId, int keyPagePosition)
+template <class Traits>
+bool BTreeIndex::appendKey(const typename Traits::KeyType &key, const RecordId rid, const char *includes)
 {
-	Page *nonLeafPage;
-	bufMgr->readPage(file, pageId, nonLeafPage);
-	Type1 *nonLeafNode = reinterpret_cast<Type1 *>(nonLeafPage);
+	typedef typename Traits::LeafNode LeafType;
 
-	Page *nonLeafKeyPage;
-	bufMgr->readPage(file, keyPageId, nonLeafKeyPage);
-	Type2 *nonLeafKeyNode = reinterpret_cast<Type2 *>(nonLeafKeyPage);
-	std::cout << "--------key: " << nonLeafKeyNode->keyArray[keyPagePosition] << std::endl;
-	for (int i = 0; i < STRINGSIZE; i++)
+	if (rightmostPath.empty() || rightmostPath.front() != BTreeIndex::rootPageNum)
 	{
-		nonLeafNode->keyArray[position][i] = nonLeafKeyNode->keyArray[keyPagePosition][i];
+		findRightmostPath<Traits>();
+	}
+	PageId leafPageId = rightmostPath.back();
+	Page *leafPage;
+	bufMgr->readPage(file, leafPageId, leafPage);
+	LeafType *leafNode = reinterpret_cast<LeafType *>(leafPage);
+	if (leafNode->size > 0 && key < Traits::value(leafNode->keyArray[leafNode->size - 1]))
+	{
+		bufMgr->unPinPage(file, leafPageId, false);
+		return false;
 	}
-	std::cout << "non leaf key: " << nonLeafNode->keyArray[position] << " position: " << position << std::endl;
-	bufMgr->unPinPage(file, pageId, true);
-	bufMgr->unPinPage(file, keyPageId, false);
-}
-
-template <class T, class LeafType, class NonLeafType>
-void BTreeIndex::splitLeafPage(PageId &rootPageNum, const void *key, const RecordId rid)
-{
-	// read the leaf page that need to be splited
-	Page* currentRootPage;
-	bufMgr->readPage(file, rootPageNum, currentRootPage);
-	bufMgr->unPinPage(file, rootPageNum, false);
-	// here pin twice because in BTreeIndex::insertEntry(), I read rootPage without pin, so I pin here
-	bufMgr->unPinPage(file, rootPageNum, false);
-	// cast it into leaf struct
-	LeafType *leafNodeLeft = reinterpret_cast<LeafType *>(currentRootPage);
 
-	// allocate a new root page
-	// unpin the page and set dirty bit to true, because we will modify it later
-	Page* newRootPage;
-	PageId newRootId;
-	bufMgr->allocPage(file, newRootId, newRootPage);
-	bufMgr->unPinPage(file, newRootId, true);
+	if (!whetherLeafIsFull<Traits>(leafNode->size))
+	{
+		Traits::store(leafNode->keyArray[leafNode->size], key);
+		storeLeafEntry<Traits>(leafNode, leafNode->size, rid, includes);
+		leafNode->size++;
+		bufMgr->unPinPage(file, leafPageId, true);
+		return true;
+	}
 
-	// read the metaData page
-	Page* headerPage;
-	bufMgr->readPage(file, headerPageNum, headerPage);
-	bufMgr->unPinPage(file, headerPageNum, true);
-	IndexMetaInfo* metaData = (IndexMetaInfo*) headerPage;
-	// update the metaData page
-	metaData->isLeafPage = false;
-	metaData->rootPageNo = newRootId;
+	// no later key goes left of this one, so the full leaf stays full
+	PageId newLeafPageId;
+	Page *newLeafPage;
+	bufMgr->allocPage(file, newLeafPageId, newLeafPage);
+	LeafType *newLeafNode = reinterpret_cast<LeafType *>(newLeafPage);
+	newLeafNode->size = 1;
+	Traits::store(newLeafNode->keyArray[0], key);
+	storeLeafEntry<Traits>(newLeafNode, 0, rid, includes);
+	newLeafNode->rightSibPageNo = Page::INVALID_NUMBER;
+	leafNode->rightSibPageNo = newLeafPageId;
+	bufMgr->unPinPage(file, newLeafPageId, true);
+	bufMgr->unPinPage(file, leafPageId, true);
 
-	/**
-	 * @brief point non leaf node to sibling
-	 */
-	NonLeafType *nonLeafNode = reinterpret_cast<NonLeafType* >(newRootPage);
-	// set level to 1 because it is just above leaf node
-	nonLeafNode->level = 1;
-	nonLeafNode->size = 1;
-	// push the right sibling's first record's key value up the non leaf node
-	insertDataNonLeaf(newRootId, 0, key);
-	// set the nonLeafNode's pointer, pointing to left sibling
-	nonLeafNode->pageNoArray[0] = rootPageNum;
-	// create a new leaf page for storing the new data
-	PageId newLeafNodeId;
-	Page* newLeafNode;
-	bufMgr->allocPage(file, newLeafNodeId, newLeafNode);
-	bufMgr->unPinPage(file, newLeafNodeId, true);
-	LeafType *leafNodeRight = reinterpret_cast<LeafType*>(newLeafNode);
-	// set the nonLeafNode's pointer, pointing to right sibling
-	nonLeafNode->pageNoArray[1] = newLeafNodeId;
-
-	/**
-	 * @brief set metaData and sibling
-	 */
-	// insert key into right sibling node
-	leafNodeRight->size = 1;
-	insertDataLeaf(newLeafNodeId, 0, key);
-	leafNodeRight->ridArray[0] = rid;
-	// point left sibling to right sibling
-	leafNodeLeft->rightSibPageNo = newLeafNodeId;
-	// update rootPageNum
-	BTreeIndex::rootPageNum = newRootId;
+	appendChild<Traits>(rightmostPath.size() - 1, key, newLeafPageId);
+	return true;
 }
 
-const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+template <class Traits>
+void BTreeIndex::appendChild(std::size_t depth, const typename Traits::KeyType &key, PageId childPageNum)
 {
-	// read the header page and cast it into IndexMetaInfo
-	Page* headerPage;
-	bufMgr->readPage(file, headerPageNum, headerPage);
-	bufMgr->unPinPage(file, headerPageNum, false);
-	IndexMetaInfo* metaDataPage = (IndexMetaInfo*) headerPage;
+	typedef typename Traits::NonLeafNode NonLeafType;
 
-	// if it a leaf page, which indicates that there is only one level 
-	// in other words, there are no nonLeafPage.
-	if (metaDataPage->isLeafPage) 
+	if (depth == 0)
 	{
-		// read the root page
-		Page *rootPage;
-		bufMgr->readPage(file, rootPageNum, rootPage);
-		
-		// insert the data if the size doesn't excced the limit
-		if (attributeType == INTEGER) 
-		{
-			if (((LeafNodeInt *)rootPage)->size < INTARRAYLEAFSIZE) 
-			{
-				// insert data into root page 
-				LeafNodeInt* leafInt = reinterpret_cast<LeafNodeInt*>(rootPage);
-				leafInt->keyArray[leafInt->size] = *(int*)key;
-				leafInt->ridArray[leafInt->size] = rid;
-				leafInt->size++;
-
-				// unpin page and set the dirty bit to true, because the data is modified
-				bufMgr->unPinPage(file, rootPageNum, true);
-			} else 
-			{
-				// handle the situation that size excced the limit
-				std::cout << "handle the situation that size excced the limit" << std::endl;
-				splitLeafPage<int, LeafNodeInt, NonLeafNodeInt>(rootPageNum, key, rid);
-			}
-		} else if (attributeType == DOUBLE) 
-		{
-			if (((LeafNodeDouble *)rootPage)->size < DOUBLEARRAYLEAFSIZE)
-			{
-				// insert data into root page
-				LeafNodeDouble *leafDouble = reinterpret_cast<LeafNodeDouble *>(rootPage);
-				leafDouble->keyArray[leafDouble->size] = *(double *)key;
-				std::cout << leafDouble->keyArray[leafDouble->size] << std::endl;
-				leafDouble->ridArray[leafDouble->size] = rid;
-				leafDouble->size++;
-
-				// unpin page and set the dirty bit to true, because the data is modified
-				bufMgr->unPinPage(file, rootPageNum, true);
-			} else 
-			{
-				// handle the situation that size excced the limit
-				splitLeafPage<double, LeafNodeDouble, NonLeafNodeDouble>(rootPageNum, key, rid);
-			}
-		} else 
-		{
-			if (((LeafNodeString *)rootPage)->size < STRINGARRAYLEAFSIZE)
-			{
-				// insert data into root page
-				LeafNodeString *leafString = reinterpret_cast<LeafNodeString *>(rootPage);
-				for (int i = 0; i < STRINGSIZE; i++)
-				{
-					leafString->keyArray[leafString->size][i] = (*(std::string*)key)[i];
-				}
-				std::cout << std::string(leafString->keyArray[leafString->size], STRINGSIZE) << " " << std::string(leafString->keyArray[std::max(leafString->size-1, 0)], STRINGSIZE) << std::endl;
-				leafString->ridArray[leafString->size] = rid;
-				leafString->size++;
-
-				// unpin page and set the dirty bit to true, because the data is modified
-				bufMgr->unPinPage(file, rootPageNum, true);
-			}
-			else
-			{
-				// handle the situation that size excced the limit
-				std::cout << "handle the situation that size excced the limit" << std::endl;
-				splitLeafPage<std::string, LeafNodeString, NonLeafNodeString>(rootPageNum, key, rid);
-			}
-		}
-	} else 
+		// the root was split: a new root above the old one and its new sibling
+		growRoot<Traits>(key, childPageNum);
+		rightmostPath[0] = childPageNum;
+		rightmostPath.insert(rightmostPath.begin(), BTreeIndex::rootPageNum);
+		return;
+	}
+
+	PageId parentPageId = rightmostPath[depth - 1];
+	Page *parentPage;
+	bufMgr->readPage(file, parentPageId, parentPage);
+	NonLeafType *parent = reinterpret_cast<NonLeafType *>(parentPage);
+	if (parent->size < nodeOccupancy)
 	{
-		if (attributeType == INTEGER) 
-		{
-			traverseNode<int, LeafNodeInt, NonLeafNodeInt>(rootPageNum, key, rid);
-		} else if (attributeType == DOUBLE) 
-		{
-			traverseNode<double, LeafNodeDouble, NonLeafNodeDouble>(rootPageNum, key, rid);
-		} else 
-		{
-			traverseNode<std::string, LeafNodeString, NonLeafNodeString>(rootPageNum, key, rid);
-		}
+		Traits::store(parent->keyArray[parent->size], key);
+		parent->size++;
+		parent->pageNoArray[parent->size] = childPageNum;
+		bufMgr->unPinPage(file, parentPageId, true);
+		rightmostPath[depth] = childPageNum;
+		return;
 	}
 
+	// the parent is full: it keeps all but its last child, which moves with the new child into a
+	// new right sibling, so every non-leaf node keeps at least one key
+	PageId siblingPageId;
+	Page *siblingPage;
+	bufMgr->allocPage(file, siblingPageId, siblingPage);
+	NonLeafType *sibling = reinterpret_cast<NonLeafType *>(siblingPage);
+	sibling->level = parent->level;
+	sibling->size = 1;
+	sibling->pageNoArray[0] = parent->pageNoArray[parent->size];
+	Traits::store(sibling->keyArray[0], key);
+	sibling->pageNoArray[1] = childPageNum;
+	typename Traits::KeyType siblingKey = Traits::value(parent->keyArray[parent->size - 1]);
+	parent->size--;
+	bufMgr->unPinPage(file, siblingPageId, true);
+	bufMgr->unPinPage(file, parentPageId, true);
+
+	rightmostPath[depth] = childPageNum;
+	appendChild<Traits>(depth - 1, siblingKey, siblingPageId);
 }
 
-bool BTreeIndex::compareNonLeafKey(PageId pageId, int index, const void* key)
-{
-	if (attributeType == INTEGER)
-	{
-		Page* nonLeafPage;
-		bufMgr->readPage(file, pageId, nonLeafPage);
-		bufMgr->unPinPage(file, pageId, false);
-		NonLeafNodeInt* nonLeafNode = reinterpret_cast<NonLeafNodeInt* >(nonLeafPage);
-		return nonLeafNode->keyArray[index] <= *(int*)key;
-	} else if (attributeType == DOUBLE)
-	{
-		Page *nonLeafPage;
-		bufMgr->readPage(file, pageId, nonLeafPage);
-		bufMgr->unPinPage(file, pageId, false);
-		NonLeafNodeDouble *nonLeafNode = reinterpret_cast<NonLeafNodeDouble *>(nonLeafPage);
-		return nonLeafNode->keyArray[index] <= *(double *)key;
-	} else
-	{
-		Page *nonLeafPage;
-		bufMgr->readPage(file, pageId, nonLeafPage);
-		bufMgr->unPinPage(file, pageId, false);
-		NonLeafNodeString *nonLeafNode = reinterpret_cast<NonLeafNodeString *>(nonLeafPage);
-		return std::string(nonLeafNode->keyArray[index], STRINGSIZE) <= (*(std::string *)(key));
-		// int res = strcmp(std::string(nonLeafNode->keyArray[index], STRINGSIZE), (*(std::string *)(key)).c_str());
-		// if (res <= 0)
-		// {
-		// 	return true;
-		// }
-		// else
-		// {
-		// 	return false;
-		// }
-	}
-}
-
-bool BTreeIndex::compareKey(void* nodeKey, const void* key)
+template <class Traits>
+void BTreeIndex::findRightmostPath()
 {
-	if (attributeType == INTEGER)
-	{
-		return *(int*)nodeKey <= *(int*)key;
-	} else if (attributeType == DOUBLE)
+	rightmostPath.clear();
+	PageId pageNum = BTreeIndex::rootPageNum;
+	rightmostPath.push_back(pageNum);
+	if (isALeafPage())
 	{
-		return *(double*)nodeKey <= *(double*)key;
-	} else 
+		return;
+	}
+	int level = 0;
+	while (level != 1)
 	{
-		std::cout << "-----------------";
-		std::cout << *(std::string*) key << "----------------" << nodeKey << std::endl;
-		int res = strcmp((char*)(nodeKey), (char *)key);
-		if (res <= 0)
-		{
-			return true;
-		}
-		else
-		{
-			return false;
-		}
+		Page *page;
+		bufMgr->readPage(file, pageNum, page);
+		typename Traits::NonLeafNode *nonLeafNode = reinterpret_cast<typename Traits::NonLeafNode *>(page);
+		level = nonLeafNode->level;
+		PageId childPageNum = nonLeafNode->pageNoArray[nonLeafNode->size];
+		bufMgr->unPinPage(file, pageNum, false);
+		rightmostPath.push_back(childPageNum);
+		pageNum = childPageNum;
 	}
 }
 
-template <class T, class LeafType, class NonLeafType>
-void BTreeIndex::splitLeafPageAndInsertEntry(PageId &rootPageNum, PageId leafPageId, const void *key, RecordId rid)
+void BTreeIndex::rightEdgeChanged(PageId pageNum)
 {
-	Page* rootPage;
-	bufMgr->readPage(file, rootPageNum, rootPage);
-	NonLeafType* rootNode = reinterpret_cast<NonLeafType* >(rootPage);
-
-	Page* leafPage;
-	bufMgr->readPage(file, leafPageId, leafPage);
-	bufMgr->unPinPage(file, leafPageId, false);
-	LeafType* leafNode = reinterpret_cast<LeafType* >(leafPage);
-	if (!whetherLeafIsFull(leafNode->size)) 
+	if (std::find(rightmostPath.begin(), rightmostPath.end(), pageNum) != rightmostPath.end())
 	{
-		throw BadIndexInfoException("the leaf node has empty space");
+		rightmostPath.clear();
 	}
+}
 
-	Page* newLeafPage;
-	PageId newLeafPageId;
-	bufMgr->allocPage(file, newLeafPageId, newLeafPage);
-	bufMgr->unPinPage(file, newLeafPageId, true);
-	LeafType* newLeafNode = reinterpret_cast<LeafType* >(newLeafPage);
-
-	insertDataLeaf(newLeafPageId, 0, key);
-	newLeafNode->size = 1;
-	newLeafNode->ridArray[0] = rid;
-	leafNode->rightSibPageNo = newLeafPageId;
-
-	// if rootPage is not full, then just update the pointer
-	if (!whetherNonLeafIsFull(rootPageNum))
-	{
-		insertDataNonLeaf(rootPageNum, rootNode->size, key);
-		rootNode->size++;
-		rootNode->pageNoArray[rootNode->size] = newLeafPageId;
-		bufMgr->unPinPage(file, rootPageNum, true);
-	} else 
+template <class Traits>
+void BTreeIndex::moveLeafEntries(typename Traits::LeafNode *src, int from, typename Traits::LeafNode *dst, int to, int count)
+{
+	if (count <= 0)
 	{
-		bufMgr->unPinPage(file, rootPageNum, false);
 		return;
 	}
+	memmove(&dst->keyArray[to], &src->keyArray[from], count * sizeof(typename Traits::NodeKey));
+	memmove(&leafRids<Traits>(dst)[to], &leafRids<Traits>(src)[from], count * sizeof(RecordId));
+	if (includeWidth > 0)
+	{
+		memmove(leafIncludes(dst, to), leafIncludes(src, from), (std::size_t)count * includeWidth);
+	}
 }
 
-template <class T, class LeafType, class NonLeafType>
-void BTreeIndex::traverseNode(PageId &rootPageNum, const void *key, RecordId rid)
+template <class Traits>
+void BTreeIndex::insertIntoLeaf(typename Traits::LeafNode *leafNode, int position, const typename Traits::KeyType &key, const RecordId rid, const char *includes)
 {
-	Page *rootPage;
-	bufMgr->readPage(file, rootPageNum, rootPage);
-	NonLeafType *nonLeafNode = reinterpret_cast<NonLeafType *>(rootPage);
+	moveLeafEntries<Traits>(leafNode, position, leafNode, position + 1, leafNode->size - position);
+	Traits::store(leafNode->keyArray[position], key);
+	storeLeafEntry<Traits>(leafNode, position, rid, includes);
+	leafNode->size++;
+}
 
-	// if it's just above the leaf Node, then check where to insert the entry
-	if (nonLeafNode->level == 1) 
-	{
-		// variable index: know the location pointing to the leaf Node
-		int index = 0;
-		for (index = 0; index < nonLeafNode->size; index++)
-		{
-			if (compareNonLeafKey(rootPageNum, index, key))
-			{
-				// if the key is greater than the key in the leaf, continue searching
-				continue;
-			}
-			else
-			{
-				// if not, break
-				break;
-			}
-		}
-		// go to leaf node according to index:
-		Page* leafPage;
-		PageId leafPageId = nonLeafNode->pageNoArray[index];
-		bufMgr->readPage(file, leafPageId, leafPage);
-		LeafType* leafNode = reinterpret_cast<LeafType* >(leafPage);
-		std::cout << "index: " << index << " key: " << leafNode->keyArray[leafNode->size - 1] << " current key: " << *(T *)key << std::endl;
-		// check if the page is filled
-		if (!whetherLeafIsFull(leafNode->size))
-		{
-			// the leaf node has space, insert key and record
-			insertDataLeaf(leafPageId, leafNode->size, key);
-			leafNode->ridArray[leafNode->size] = rid; 
-			leafNode->size++;
-			bufMgr->unPinPage(file, leafPageId, true);
-			bufMgr->unPinPage(file, rootPageNum, false);
-		}
-		else {
-			// split page when leaf Node is full
-			std::cout << "leaf node is filled, key is: " << *(T*)key << std::endl;
-			bufMgr->unPinPage(file, leafPageId, false);
-			splitLeafPageAndInsertEntry<T, LeafType, NonLeafType>(rootPageNum, leafPageId, key, rid);
-			bufMgr->unPinPage(file, rootPageNum, true);
-			// if the node is not the global root node, it can be done recursivly
-			// if so, then we need to create a new global root and update the meta data
-			if (whetherNonLeafIsFull(rootPageNum) && rootPageNum == BTreeIndex::rootPageNum) 
-			{
-				std::cout << "root node is filled, size is:" << nonLeafNode->size << " key is: " << *(T *)key << std::endl;
-				Page* newLeafPage;
-				PageId newLeafPageId = nonLeafNode->pageNoArray[nonLeafNode->size];
-				bufMgr->readPage(file, newLeafPageId, newLeafPage);
-				bufMgr->unPinPage(file, newLeafPageId, false);
-				LeafType* newLeafNode = reinterpret_cast<LeafType* >(newLeafPage);
-				std::cout << "size: " << newLeafNode->size << " key: " << newLeafNode->keyArray[newLeafNode->size - 1] << std::endl;
-				if (!whetherLeafIsFull(newLeafNode->size))
-				{
-					throw BadIndexInfoException("the leaf Node should be filled");
-				}
-
-				Page* newLeafRightSiblingPage;
-				PageId newLeafRightSiblingPageId = newLeafNode->rightSibPageNo;
-				bufMgr->readPage(file, newLeafRightSiblingPageId, newLeafRightSiblingPage);
-				bufMgr->unPinPage(file, newLeafRightSiblingPageId, false);
-				LeafType *newLeafRightSiblingNode = reinterpret_cast<LeafType *>(newLeafRightSiblingPage);
-				if (newLeafRightSiblingNode->size != 1) 
-				{
-					throw BadIndexInfoException("the size of the node should be 1");
-				}
-
-				Page* rootRightSiblingPage;
-				PageId rootRightSiblingPageId;
-				bufMgr->allocPage(file, rootRightSiblingPageId, rootRightSiblingPage);
-				bufMgr->unPinPage(file, rootRightSiblingPageId, true);
-				NonLeafType *nonLeafRightSiblingNode = reinterpret_cast<NonLeafType *>(rootRightSiblingPage);
-				nonLeafRightSiblingNode->level = 1;
-				nonLeafRightSiblingNode->size = 0;
-				if (attributeType == STRING) 
-				{
-					insertDataAnyTypeString<NonLeafNodeString, LeafNodeString>(rootRightSiblingPageId, 0, newLeafRightSiblingPageId, 0);
-				} else 
-				{
-					insertDataNonLeaf(rootRightSiblingPageId, 0, &newLeafRightSiblingNode->keyArray[0]);
-				}
-				nonLeafRightSiblingNode->pageNoArray[0] = newLeafPageId;
-				nonLeafRightSiblingNode->size++;
-				nonLeafRightSiblingNode->pageNoArray[1] = newLeafRightSiblingPageId;
-				// remeber to subtract the size of current root node
-				nonLeafNode->size--;
-
-				Page* globalRootPage;
-				PageId globalRootPageId;
-				bufMgr->allocPage(file, globalRootPageId, globalRootPage);
-				bufMgr->unPinPage(file, globalRootPageId, true);
-				NonLeafType *globalRootNode = reinterpret_cast<NonLeafType *>(globalRootPage);
-				globalRootNode->level = 0;
-				globalRootNode->size = 0;
-				if (attributeType == STRING)
-				{
-					// insertDataAnyTypeString<NonLeafNodeString, NonLeafNodeString>(globalRootPageId, 0, rootRightSiblingPageId, 0);
-					insertDataAnyTypeString<NonLeafNodeString, LeafNodeString>(globalRootPageId, 0, newLeafPageId, 0);
-				} else 
-				{
-					// insertDataNonLeaf(globalRootPageId, 0, &nonLeafRightSiblingNode->keyArray[0]);
-					insertDataNonLeaf(globalRootPageId, 0, &newLeafNode->keyArray[0]);
-				}
-				globalRootNode->pageNoArray[0] = rootPageNum;
-				globalRootNode->size++;
-				globalRootNode->pageNoArray[1] = rootRightSiblingPageId;
-
-				// update the metaData
-				Page* headerPage;
-				PageId headerPageId = BTreeIndex::headerPageNum;
-				if (headerPageId != 1)
-				{
-					throw BadIndexInfoException("the header page id shoule be 1");
-				}
-				bufMgr->readPage(file, headerPageId, headerPage);
-				bufMgr->unPinPage(file, headerPageId, true);
-				IndexMetaInfo* metaData = (IndexMetaInfo*) headerPage;
-				metaData->rootPageNo = globalRootPageId;
-				BTreeIndex::rootPageNum = globalRootPageId;
-			}
-		}
-	} else 
-	{
-		std::cout << "traverse start key: " << nonLeafNode->keyArray[nonLeafNode->size-1];
-		int index = 0;
-		for (index = 0; index < nonLeafNode->size; index++) 
-		{
-			if (compareNonLeafKey(rootPageNum, index, key)) 
-			{
-				// if the key is greater than the key in the leaf, continue searching
-				continue;
-			}
-			else
-			{
-				// if not, break
-				break;
-			}
-		}
-		PageId nextLevelPageId = nonLeafNode->pageNoArray[index];
-		std::cout << "  index: " << index << " page number: " << nextLevelPageId << " root page number: " << rootPageNum << std::endl;
-		traverseNode<T, LeafType, NonLeafType>(nextLevelPageId, key, rid);
-
-		Page* NonLeafPage;
-		bufMgr->readPage(file, nextLevelPageId, NonLeafPage);
-		NonLeafType* NextLevelNonLeafNode = reinterpret_cast<NonLeafType* >(NonLeafPage);
-		if (whetherNonLeafIsFull(nextLevelPageId))
-		{
-			fullTime += 1;
-			if (fullTime % 2 == 1) {
-				return;
-			}
-			// here dirty bit is set to true because later we will subtract size and assign
-			// the node to its right sibling
-			bufMgr->unPinPage(file, nextLevelPageId, true);
-			
-			// find the Id
-			PageId targetId = NextLevelNonLeafNode->pageNoArray[NextLevelNonLeafNode->size];
-			Page* searchPage;
-			bufMgr->readPage(file, targetId, searchPage);
-			bufMgr->unPinPage(file, targetId, false);
-			// we assume the height is 3, otherwise we need a hashmap <pageId, type of node>
-			// to see if it is a leaf node or a non leaf node
-			LeafType* newLeafNode = reinterpret_cast<LeafType* >(searchPage);
-			if (!whetherLeafIsFull(newLeafNode->size))
-			{
-				throw BadIndexInfoException("the leaf Node should be filled");
-			}
-			PageId IdWeWant = newLeafNode->rightSibPageNo;
-
-			// Read the Page and find the key
-			Page* PageWeWant;
-			bufMgr->readPage(file, IdWeWant, PageWeWant);
-			bufMgr->unPinPage(file, IdWeWant, false);
-			LeafType* NodeWeWant = reinterpret_cast<LeafType* >(PageWeWant);
-			if (NodeWeWant->size != 1) 
-			{
-				throw BadIndexInfoException("the size of the node should be 1");
-			}
-			Page *newNonLeafPage;
-			PageId newNonLeafPageId;
-			bufMgr->allocPage(file, newNonLeafPageId, newNonLeafPage);
-			bufMgr->unPinPage(file, newNonLeafPageId, true);
-			NonLeafType *newNonLeafNode = reinterpret_cast<NonLeafType *>(newNonLeafPage);
-			newNonLeafNode->level = 1;
-			newNonLeafNode->size = 0;
-			// insert key
-			if (attributeType == STRING)
-			{
-				insertDataAnyTypeString<NonLeafNodeString, LeafNodeString>(newNonLeafPageId, newNonLeafNode->size, IdWeWant, 0);
-			} else 
-			{
-				insertDataNonLeaf(newNonLeafPageId, newNonLeafNode->size, &NodeWeWant->keyArray[0]);
-			}
-			newNonLeafNode->pageNoArray[newNonLeafNode->size] = targetId;
-			newNonLeafNode->size++;
-			newNonLeafNode->pageNoArray[newNonLeafNode->size] = IdWeWant;
-
-			// update root node
-			if (whetherNonLeafIsFull(rootPageNum)) 
-			{
-				throw BadIndexInfoException("the height of the B+ Tree is over 3, need more complicated implementation");
-			}
-			/**
-			 * @brief here need to subtract size because we have assign the right most to another node
-			 */
-			NextLevelNonLeafNode->size--;
-			if (attributeType == STRING)
-			{
-				// insertDataAnyTypeString<NonLeafNodeString, NonLeafNodeString>(rootPageNum, nonLeafNode->size, newNonLeafPageId, newNonLeafNode->size - 1);
-				insertDataAnyTypeString<NonLeafNodeString, LeafNodeString>(rootPageNum, nonLeafNode->size, targetId, 0);
-			} else 
-			{
-				// insertDataNonLeaf(rootPageNum, nonLeafNode->size, &newNonLeafNode->keyArray[newNonLeafNode->size - 1]);
-				insertDataNonLeaf(rootPageNum, nonLeafNode->size, &newLeafNode->keyArray[0]);
-			}
-			nonLeafNode->size++;
-			nonLeafNode->pageNoArray[nonLeafNode->size] = newNonLeafPageId;
-			bufMgr->unPinPage(file, rootPageNum, true);
-		} else 
-		{
-			bufMgr->unPinPage(file, nextLevelPageId, false);
-		}
-	}
+template <class Traits>
+void BTreeIndex::insertIntoNonLeaf(typename Traits::NonLeafNode *nonLeafNode, int position, const typename Traits::KeyType &key, PageId childPageNum)
+{
+	const int moved = nonLeafNode->size - position;
+	memmove(&nonLeafNode->keyArray[position + 1], &nonLeafNode->keyArray[position], moved * sizeof(typename Traits::NodeKey));
+	memmove(&nonLeafNode->pageNoArray[position + 2], &nonLeafNode->pageNoArray[position + 1], moved * sizeof(PageId));
+	Traits::store(nonLeafNode->keyArray[position], key);
+	nonLeafNode->pageNoArray[position + 1] = childPageNum;
+	nonLeafNode->size++;
 }
 
-bool BTreeIndex::whetherLeafIsFull(int size) 
+template <class Traits>
+bool BTreeIndex::insertLeafEntry(PageId leafPageNum, const typename Traits::KeyType &key, const RecordId rid, const char *includes,
+								 typename Traits::KeyType &splitKey, PageId &splitPageNum)
 {
-	if (attributeType == INTEGER) 
+	typedef typename Traits::LeafNode LeafType;
+
+	Page *leafPage;
+	bufMgr->readPage(file, leafPageNum, leafPage);
+	LeafType *leafNode = reinterpret_cast<LeafType *>(leafPage);
+	// after every equal key, so that duplicates keep their insertion order
+	const int position = Traits::upperBound(leafNode->keyArray, leafNode->size, key);
+	if (!whetherLeafIsFull<Traits>(leafNode->size))
 	{
-		if (size < INTARRAYLEAFSIZE) 
-		{
-			return false;
-		} else 
-		{
-			return true;
-		}
-	} else if (attributeType == DOUBLE) 
+		insertIntoLeaf<Traits>(leafNode, position, key, rid, includes);
+		bufMgr->unPinPage(file, leafPageNum, true);
+		return false;
+	}
+
+	// split in half: the upper half of the entries, counting the new one, moves to a new right sibling
+	Page *siblingPage;
+	bufMgr->allocPage(file, splitPageNum, siblingPage);
+	LeafType *sibling = reinterpret_cast<LeafType *>(siblingPage);
+	const int size = leafNode->size;
+	const int leftSize = (size + 1) / 2;
+	if (position < leftSize)
 	{
-		if (size < DOUBLEARRAYLEAFSIZE)
-		{
-			return false;
-		} else 
-		{
-			return true;
-		}
-	} else 
+		moveLeafEntries<Traits>(leafNode, leftSize - 1, sibling, 0, size - leftSize + 1);
+		sibling->size = size - leftSize + 1;
+		leafNode->size = leftSize - 1;
+		insertIntoLeaf<Traits>(leafNode, position, key, rid, includes);
+	}
+	else
 	{
-		if (size < STRINGARRAYLEAFSIZE) 
-		{
-			return false;
-		} else 
-		{
-			return true;
-		}
+		moveLeafEntries<Traits>(leafNode, leftSize, sibling, 0, size - leftSize);
+		sibling->size = size - leftSize;
+		leafNode->size = leftSize;
+		insertIntoLeaf<Traits>(sibling, position - leftSize, key, rid, includes);
 	}
+	sibling->rightSibPageNo = leafNode->rightSibPageNo;
+	leafNode->rightSibPageNo = splitPageNum;
+	splitKey = Traits::value(sibling->keyArray[0]);
+	rightEdgeChanged(leafPageNum);
+
+	bufMgr->unPinPage(file, splitPageNum, true);
+	bufMgr->unPinPage(file, leafPageNum, true);
+	return true;
 }
 
-bool BTreeIndex::whetherNonLeafIsFull(PageId pageId) 
+template <class Traits>
+bool BTreeIndex::traverseNode(PageId pageNum, const typename Traits::KeyType &key, const RecordId rid, const char *includes,
+							  typename Traits::KeyType &splitKey, PageId &splitPageNum)
 {
-	Page* nonLeafPage;
-	bufMgr->readPage(file, pageId, nonLeafPage);
-	bufMgr->unPinPage(file, pageId, false);
-	if (attributeType == INTEGER)
+	typedef typename Traits::NonLeafNode NonLeafType;
+
+	Page *page;
+	bufMgr->readPage(file, pageNum, page);
+	NonLeafType *nonLeafNode = reinterpret_cast<NonLeafType *>(page);
+	const int index = childIndex<Traits>(nonLeafNode, key);
+	const PageId childPageNum = nonLeafNode->pageNoArray[index];
+	const bool childIsLeaf = nonLeafNode->level == 1;
+	bufMgr->unPinPage(file, pageNum, false);
+
+	typename Traits::KeyType childSplitKey;
+	PageId childSplitPageNum;
+	const bool childSplit = childIsLeaf
+		? insertLeafEntry<Traits>(childPageNum, key, rid, includes, childSplitKey, childSplitPageNum)
+		: traverseNode<Traits>(childPageNum, key, rid, includes, childSplitKey, childSplitPageNum);
+	if (!childSplit)
 	{
-		NonLeafNodeInt* NonLeafNode = reinterpret_cast<NonLeafNodeInt* >(nonLeafPage);
-		int size = NonLeafNode->size;
-		if (size < INTARRAYNONLEAFSIZE)
-		{
-			return false;
-		}
-		else
-		{
-			Page* leafPage;
-			PageId leafPageId = NonLeafNode->pageNoArray[NonLeafNode->size];
-			bufMgr->readPage(file, leafPageId, leafPage);
-			bufMgr->unPinPage(file, leafPageId, false);
-			LeafNodeInt* LeafNode = reinterpret_cast<LeafNodeInt* >(leafPage);
-			if (LeafNode->size < INTARRAYLEAFSIZE) 
-			{
-				return false;
-			}
-			else 
-			{
-				return true;
-			}
-		}
+		return false;
 	}
-	else if (attributeType == DOUBLE)
+
+	// the child's new right sibling goes right after it
+	bufMgr->readPage(file, pageNum, page);
+	nonLeafNode = reinterpret_cast<NonLeafType *>(page);
+	if (nonLeafNode->size < nodeOccupancy)
 	{
-		NonLeafNodeDouble *NonLeafNode = reinterpret_cast<NonLeafNodeDouble *>(nonLeafPage);
-		int size = NonLeafNode->size;
-		if (size < DOUBLEARRAYNONLEAFSIZE)
-		{
-			return false;
-		}
-		else
-		{
-			Page *leafPage;
-			PageId leafPageId = NonLeafNode->pageNoArray[NonLeafNode->size];
-			bufMgr->readPage(file, leafPageId, leafPage);
-			bufMgr->unPinPage(file, leafPageId, false);
-			LeafNodeDouble *LeafNode = reinterpret_cast<LeafNodeDouble *>(leafPage);
-			if (LeafNode->size < DOUBLEARRAYLEAFSIZE)
-			{
-				return false;
-			}
-			else
-			{
-				return true;
-			}
-		}
+		insertIntoNonLeaf<Traits>(nonLeafNode, index, childSplitKey, childSplitPageNum);
+		bufMgr->unPinPage(file, pageNum, true);
+		return false;
+	}
+
+	// split in half: the middle key, counting the new one, moves up and the keys after it go to a
+	// new right sibling together with their children
+	Page *siblingPage;
+	bufMgr->allocPage(file, splitPageNum, siblingPage);
+	NonLeafType *sibling = reinterpret_cast<NonLeafType *>(siblingPage);
+	sibling->level = nonLeafNode->level;
+	const int size = nonLeafNode->size;
+	const int middle = (size + 1) / 2;
+	if (index < middle)
+	{
+		splitKey = Traits::value(nonLeafNode->keyArray[middle - 1]);
+		sibling->size = size - middle;
+		memcpy(&sibling->keyArray[0], &nonLeafNode->keyArray[middle], sibling->size * sizeof(typename Traits::NodeKey));
+		memcpy(&sibling->pageNoArray[0], &nonLeafNode->pageNoArray[middle], (sibling->size + 1) * sizeof(PageId));
+		nonLeafNode->size = middle - 1;
+		insertIntoNonLeaf<Traits>(nonLeafNode, index, childSplitKey, childSplitPageNum);
+	}
+	else if (index == middle)
+	{
+		splitKey = childSplitKey;
+		sibling->size = size - middle;
+		memcpy(&sibling->keyArray[0], &nonLeafNode->keyArray[middle], sibling->size * sizeof(typename Traits::NodeKey));
+		sibling->pageNoArray[0] = childSplitPageNum;
+		memcpy(&sibling->pageNoArray[1], &nonLeafNode->pageNoArray[middle + 1], sibling->size * sizeof(PageId));
+		nonLeafNode->size = middle;
 	}
 	else
 	{
-		NonLeafNodeString *NonLeafNode = reinterpret_cast<NonLeafNodeString *>(nonLeafPage);
-		int size = NonLeafNode->size;
-		if (size < STRINGARRAYNONLEAFSIZE)
-		{
-			return false;
-		}
-		else
-		{
-			Page *leafPage;
-			PageId leafPageId = NonLeafNode->pageNoArray[NonLeafNode->size];
-			bufMgr->readPage(file, leafPageId, leafPage);
-			bufMgr->unPinPage(file, leafPageId, false);
-			LeafNodeString *LeafNode = reinterpret_cast<LeafNodeString *>(leafPage);
-			if (LeafNode->size < STRINGARRAYLEAFSIZE)
-			{
-				return false;
-			}
-			else
-			{
-				return true;
-			}
-		}
+		splitKey = Traits::value(nonLeafNode->keyArray[middle]);
+		sibling->size = size - middle - 1;
+		memcpy(&sibling->keyArray[0], &nonLeafNode->keyArray[middle + 1], sibling->size * sizeof(typename Traits::NodeKey));
+		memcpy(&sibling->pageNoArray[0], &nonLeafNode->pageNoArray[middle + 1], (sibling->size + 1) * sizeof(PageId));
+		nonLeafNode->size = middle;
+		insertIntoNonLeaf<Traits>(sibling, index - middle - 1, childSplitKey, childSplitPageNum);
 	}
+	rightEdgeChanged(pageNum);
+
+	bufMgr->unPinPage(file, splitPageNum, true);
+	bufMgr->unPinPage(file, pageNum, true);
+	return true;
+}
+
+template <class Traits>
+void BTreeIndex::growRoot(const typename Traits::KeyType &splitKey, PageId splitPageNum)
+{
+	typedef typename Traits::NonLeafNode NonLeafType;
+
+	const bool rootIsLeaf = isALeafPage();
+	PageId newRootId;
+	Page *newRootPage;
+	bufMgr->allocPage(file, newRootId, newRootPage);
+	NonLeafType *newRoot = reinterpret_cast<NonLeafType *>(newRootPage);
+	newRoot->level = rootIsLeaf ? 1 : 0;
+	newRoot->size = 1;
+	Traits::store(newRoot->keyArray[0], splitKey);
+	newRoot->pageNoArray[0] = BTreeIndex::rootPageNum;
+	newRoot->pageNoArray[1] = splitPageNum;
+	bufMgr->unPinPage(file, newRootId, true);
+
+	Page *headerPage;
+	bufMgr->readPage(file, headerPageNum, headerPage);
+	IndexMetaInfo *metaData = (IndexMetaInfo *)headerPage;
+	metaData->rootPageNo = newRootId;
+	metaData->isLeafPage = false;
+	bufMgr->unPinPage(file, headerPageNum, true);
+
+	BTreeIndex::rootPageNum = newRootId;
+}
+
+template <class Traits>
+bool BTreeIndex::whetherLeafIsFull(int size) 
+{
+	return size >= leafOccupancy;
 }
 
 // -----------------------------------------------------------------------------
@@ -941,148 +901,35 @@ bool BTreeIndex::isALeafPage()
 	return metaData->isLeafPage;
 }
 
-template <class T>
-bool BTreeIndex::judgeKey(T key, T ValParm, const Operator OpParm)
-{
-	if (BTreeIndex::attributeType == INTEGER)
-	{
-		if (OpParm == GT)
-		{
-			return key > ValParm;
-		}
-		else if (OpParm == GTE)
-		{
-			return key >= ValParm;
-		}
-		else if (OpParm == LT)
-		{
-			return key < ValParm;
-		}
-		else if (OpParm == LTE)
-		{
-			return key <= ValParm;
-		}
-		else
-		{
-			throw BadIndexInfoException("unknown operator");
-		}
-	}
-	else if (BTreeIndex::attributeType == DOUBLE)
-	{
-		if (OpParm == GT)
-		{
-			return key > ValParm;
-		}
-		else if (OpParm == GTE)
-		{
-			return key >= ValParm;
-		}
-		else if (OpParm == LT)
-		{
-			return key < ValParm;
-		}
-		else if (OpParm == LTE)
-		{
-			return key <= ValParm;
-		}
-		else
-		{
-			throw BadIndexInfoException("unknown operator");
-		}
-	}
-	else if (BTreeIndex::attributeType == STRING)
-	{
-		if (OpParm == GT)
-		{
-			return key > ValParm;
-		}
-		else if (OpParm == GTE)
-		{
-			return key >= ValParm;
-		}
-		else if (OpParm == LT)
-		{
-			return key < ValParm;
-		}
-		else if (OpParm == LTE)
-		{
-			return key <= ValParm;
-		}
-		else
-		{
-			throw BadIndexInfoException("unknown operator");
-		}
-	}
-	else
-	{
-		throw BadIndexInfoException("unknown attribute type");
-	}
-}
-
-void BTreeIndex::traverseLeafPage(PageId rootPageNum, const void *lowValParm, const Operator lowOpParm)
+template <class Traits>
+void BTreeIndex::traverseLeafPage(IndexCursor &cursor, PageId rootPageNum, const Operator lowOpParm)
 {
-	Page *rootPage;
-	bufMgr->readPage(file, rootPageNum, rootPage);
-	bufMgr->unPinPage(file, rootPageNum, false);
+	const typename Traits::KeyType &lowVal = cursor.scanLowVal<Traits>();
 
-	if (BTreeIndex::attributeType == INTEGER)
-	{
-		LeafNodeInt *leafNode = reinterpret_cast<LeafNodeInt *>(rootPage);
-		int index;
-		for (index = 0; index < leafNode->size; index++)
-		{
-			std::cout << leafNode->keyArray[index] << " ";
-			if (judgeKey<int>(leafNode->keyArray[index], BTreeIndex::lowValInt, lowOpParm))
-			{
-				break;
-			}
-		}
-		std::cout << std::endl;
-		if (index == leafNode->size || leafNode->size == 0)
-		{
-			throw NoSuchKeyFoundException();
-		}
-		BTreeIndex::currentPageNum = rootPageNum;
-		BTreeIndex::nextEntry = index;
-	}
-	else if (BTreeIndex::attributeType == DOUBLE)
+	// the first key satisfying the low bound may sit in a right sibling when every key of this
+	// leaf is below the bound, so keep following rightSibPageNo until one is found
+	while (1)
 	{
-		LeafNodeDouble *leafNode = reinterpret_cast<LeafNodeDouble *>(rootPage);
-		int index;
-		for (index = 0; index < leafNode->size; index++)
-		{
-			std::cout << leafNode->keyArray[index] << " ";
-			if (judgeKey<double>(leafNode->keyArray[index], BTreeIndex::lowValDouble, lowOpParm))
-			{
-				break;
-			}
-		}
-		std::cout << std::endl;
-		if (index == leafNode->size || leafNode->size == 0)
+		// keep the leaf pinned while reading it: the prefetcher may reuse unpinned frames
+		Page *rootPage;
+		bufMgr->readPage(file, rootPageNum, rootPage);
+		typename Traits::LeafNode *leafNode = reinterpret_cast<typename Traits::LeafNode *>(rootPage);
+		int index = lowBoundIndex<Traits>(leafNode->keyArray, leafNode->size, lowVal, lowOpParm);
+		if (index < leafNode->size)
 		{
-			throw NoSuchKeyFoundException();
+			// the cursor keeps this pin
+			cursor.moveTo(rootPageNum, rootPage);
+			cursor.nextEntry = index;
+			return;
 		}
-		BTreeIndex::currentPageNum = rootPageNum;
-		BTreeIndex::nextEntry = index;
-	}
-	else
-	{
-		LeafNodeString *leafNode = reinterpret_cast<LeafNodeString *>(rootPage);
-		int index;
-		for (index = 0; index < leafNode->size; index++)
-		{
-			std::cout << std::string(leafNode->keyArray[index], STRINGSIZE) << endl;
-			if (judgeKey<std::string>(std::string(leafNode->keyArray[index], STRINGSIZE), BTreeIndex::lowValString, lowOpParm))
-			{
-				break;
-			}
-		}
-		if (index == leafNode->size || leafNode->size == 0)
+		PageId rightSibPageNo = leafNode->rightSibPageNo;
+		bufMgr->unPinPage(file, rootPageNum, false);
+
+		if (rightSibPageNo == Page::INVALID_NUMBER)
 		{
 			throw NoSuchKeyFoundException();
 		}
-		BTreeIndex::currentPageNum = rootPageNum;
-		BTreeIndex::nextEntry = index;
+		rootPageNum = rightSibPageNo;
 	}
 }
 
@@ -1092,11 +939,19 @@ const void BTreeIndex::startScan(const void *lowValParm,
 								 const Operator highOpParm)
 {
 	// if another scan is excuting, should be end here
-	if (BTreeIndex::scanExecuting)
+	if (scanCursor != NULL)
 	{
 		throw BadIndexInfoException("another scan is executing");
 	}
+	scanCursor = new IndexCursor(*this, lowValParm, lowOpParm, highValParm, highOpParm);
+}
 
+void BTreeIndex::startScan(IndexCursor &cursor,
+						   const void *lowValParm,
+						   const Operator lowOpParm,
+						   const void *highValParm,
+						   const Operator highOpParm)
+{
 	// check lowOpParm: only support GT and GTE here
 	if (lowOpParm != GT && lowOpParm != GTE)
 	{
@@ -1104,308 +959,412 @@ const void BTreeIndex::startScan(const void *lowValParm,
 		throw BadOpcodesException();
 	}
 	// check highOpParm: only support LT and LTE here
-	std::cout << "high " << highOpParm << endl;
 	if (highOpParm != LT && highOpParm != LTE)
 	{
 		std::cout << "high " << highOpParm << endl;
 		throw BadOpcodesException();
 	}
 
-	// check if lowValParm is less than highValParm
+	cursor.lowOp = lowOpParm;
+	cursor.highOp = highOpParm;
+
 	if (BTreeIndex::attributeType == INTEGER)
 	{
-		if (*(int *)lowValParm > *(int *)highValParm)
-		{
-			throw BadScanrangeException();
-		}
-		BTreeIndex::lowValInt = *(int *)lowValParm;
-		BTreeIndex::highValInt = *(int *)highValParm;
+		startScan<IntKeyTraits>(cursor, lowValParm, highValParm);
 	}
 	else if (BTreeIndex::attributeType == DOUBLE)
 	{
-		if (*(double *)lowValParm > *(double *)highValParm)
-		{
-			throw BadScanrangeException();
-		}
-		BTreeIndex::lowValDouble = *(double *)lowValParm;
-		BTreeIndex::highValDouble = *(double *)highValParm;
+		startScan<DoubleKeyTraits>(cursor, lowValParm, highValParm);
 	}
 	else
 	{
-		if ((std::string)((char *)lowValParm) > (std::string)((char *)highValParm))
-		{
-			throw BadScanrangeException();
-		}
-		BTreeIndex::lowValString = ((std::string)((char *)lowValParm)).substr(0, STRINGSIZE);
-		BTreeIndex::highValString = ((std::string)((char *)highValParm)).substr(0, STRINGSIZE);
+		startScan<StringKeyTraits>(cursor, lowValParm, highValParm);
 	}
+}
 
-	BTreeIndex::scanExecuting = true;
+template <class Traits>
+void BTreeIndex::startScan(IndexCursor &cursor, const void *lowValParm, const void *highValParm)
+{
+	// check if lowValParm is less than highValParm
+	typename Traits::KeyType lowVal = Traits::fromScanParam(lowValParm);
+	typename Traits::KeyType highVal = Traits::fromScanParam(highValParm);
+	if (lowVal > highVal)
+	{
+		throw BadScanrangeException();
+	}
+	cursor.scanLowVal<Traits>() = lowVal;
+	cursor.scanHighVal<Traits>() = highVal;
 
-	BTreeIndex::lowOp = lowOpParm;
-	BTreeIndex::highOp = highOpParm;
-
-	Page *rootPage;
-	bufMgr->readPage(file, rootPageNum, rootPage);
-	bufMgr->unPinPage(file, rootPageNum, false);
+	// read-ahead starts once the descent reaches the level above the leaves
+	cursor.prefetchParentNum = Page::INVALID_NUMBER;
 
 	// if it is a leaf page, then just traverse it
 	if (isALeafPage())
 	{
-		traverseLeafPage(BTreeIndex::rootPageNum, lowValParm, lowOpParm);
+		traverseLeafPage<Traits>(cursor, BTreeIndex::rootPageNum, cursor.lowOp);
 	}
 	else
 	{
 		// if it's not a leaf page, traverse recursivly and find the page that we want
-		std::cout << "recursive traverse" << std::endl;
-		traverseLeafPageRecursivly(BTreeIndex::rootPageNum, lowValParm, lowOpParm);
+		traverseLeafPageRecursivly<Traits>(cursor, BTreeIndex::rootPageNum, cursor.lowOp);
 	}
+	cursor.scanExecuting = true;
 }
 
-void BTreeIndex::traverseLeafPageRecursivly(PageId rootPageNum, const void *lowValParm, const Operator lowOpParm)
+template <class Traits>
+void BTreeIndex::traverseLeafPageRecursivly(IndexCursor &cursor, PageId rootPageNum, const Operator lowOpParm)
 {
+	const typename Traits::KeyType &lowVal = cursor.scanLowVal<Traits>();
+
 	Page *rootPage;
 	bufMgr->readPage(file, rootPageNum, rootPage);
+	typename Traits::NonLeafNode *nonLeafNode = reinterpret_cast<typename Traits::NonLeafNode *>(rootPage);
+	// duplicates of a separator may sit on both sides of it, so a GTE scan descends left of a
+	// separator equal to lowVal; traverseLeafPage() moves right when that leaf holds no match
+	int index = lowBoundIndex<Traits>(nonLeafNode->keyArray, nonLeafNode->size, lowVal, lowOpParm);
+	int size = nonLeafNode->size;
+	int level = nonLeafNode->level;
+	PageId childPageNum = nonLeafNode->pageNoArray[index];
 	bufMgr->unPinPage(file, rootPageNum, false);
+
+	if (size == 0)
+	{
+		throw NoSuchKeyFoundException();
+	}
+	// if it is just above the leaf page, then just call traverseLeafPage
+	if (level == 1)
+	{
+		startLeafReadAhead<Traits>(cursor, rootPageNum, index);
+		traverseLeafPage<Traits>(cursor, childPageNum, lowOpParm);
+	}
+	else
+	{
+		// if it is not above the leaf page, then just call func recrusivly
+		traverseLeafPageRecursivly<Traits>(cursor, childPageNum, lowOpParm);
+	}
+}
+
+void BTreeIndex::setPrefetchWindow(std::uint32_t pages)
+{
+	prefetchWindow = pages;
+}
+
+template <class Traits>
+void BTreeIndex::startLeafReadAhead(IndexCursor &cursor, PageId parentPageNum, int childIndex)
+{
+	cursor.prefetchParentNum = parentPageNum;
+	cursor.prefetchNextChild = childIndex + 1;
+	cursor.prefetchParentDone = false;
+	cursor.leavesAhead = 0;
+	readAheadLeaves<Traits>(cursor);
+}
+
+template <class Traits>
+void BTreeIndex::advanceLeafReadAhead(IndexCursor &cursor, PageId nextSibPageNo)
+{
+	if (prefetchWindow == 0 || cursor.prefetchParentNum == Page::INVALID_NUMBER)
+	{
+		return;
+	}
+	if (cursor.leavesAhead > 0)
+	{
+		cursor.leavesAhead--;
+	}
+	if (!cursor.prefetchParentDone)
+	{
+		readAheadLeaves<Traits>(cursor);
+	}
+	else if (cursor.leavesAhead == 0 && nextSibPageNo != Page::INVALID_NUMBER)
+	{
+		// past the parent's leaves: the sibling pointer is all we know
+		bufMgr->prefetchPages(file, std::vector<PageId>(1, nextSibPageNo));
+	}
+}
+
+template <class Traits>
+void BTreeIndex::readAheadLeaves(IndexCursor &cursor)
+{
+	if (prefetchWindow == 0 || cursor.prefetchParentDone || cursor.leavesAhead > prefetchWindow / 2)
+	{
+		return;
+	}
+
+	Page *parentPage;
+	bufMgr->readPage(file, cursor.prefetchParentNum, parentPage);
+	typename Traits::NonLeafNode *parent = reinterpret_cast<typename Traits::NonLeafNode *>(parentPage);
+
+	// a node with size keys has size + 1 children
+	std::vector<PageId> pageNos;
+	while (cursor.leavesAhead < prefetchWindow && cursor.prefetchNextChild <= parent->size)
+	{
+		pageNos.push_back(parent->pageNoArray[cursor.prefetchNextChild++]);
+		cursor.leavesAhead++;
+	}
+	cursor.prefetchParentDone = cursor.prefetchNextChild > parent->size;
+	bufMgr->unPinPage(file, cursor.prefetchParentNum, false);
+
+	bufMgr->prefetchPages(file, pageNos);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+
+const void BTreeIndex::scanNext(RecordId& outRid) 
+{
+	if (scanCursor == NULL)
+	{
+		throw ScanNotInitializedException();
+	}
+	scanCursor->scanNext(outRid);
+}
+
+int BTreeIndex::scanNextBatch(RecordId *outRids, void *outKeys, int maxEntries)
+{
+	if (scanCursor == NULL)
+	{
+		throw ScanNotInitializedException();
+	}
+	return scanCursor->scanNextBatch(outRids, outKeys, maxEntries);
+}
+
+int BTreeIndex::scanNextBatch(RecordId *outRids, void *outKeys, char *outIncludes, int maxEntries)
+{
+	if (scanCursor == NULL)
+	{
+		throw ScanNotInitializedException();
+	}
+	return scanCursor->scanNextBatch(outRids, outKeys, outIncludes, maxEntries);
+}
+
+int BTreeIndex::scanNextBatch(IndexCursor &cursor, RecordId *outRids, void *outKeys, char *outIncludes, int maxEntries)
+{
+	// 0 entries returned means the range has ended, so an empty batch cannot be asked for
+	if (maxEntries <= 0)
+	{
+		throw BadScanParamException();
+	}
 	if (BTreeIndex::attributeType == INTEGER)
 	{
-		NonLeafNodeInt *nonLeafNode = reinterpret_cast<NonLeafNodeInt *>(rootPage);
-		int index;
-		for (index = 0; index < nonLeafNode->size; index++)
+		return scanNextBatch<IntKeyTraits>(cursor, outRids, (int *)outKeys, outIncludes, maxEntries);
+	}
+	else if (BTreeIndex::attributeType == DOUBLE)
+	{
+		return scanNextBatch<DoubleKeyTraits>(cursor, outRids, (double *)outKeys, outIncludes, maxEntries);
+	}
+	else
+	{
+		return scanNextBatch<StringKeyTraits>(cursor, outRids, (std::string *)outKeys, outIncludes, maxEntries);
+	}
+}
+
+template <class Traits>
+int BTreeIndex::scanNextBatch(IndexCursor &cursor, RecordId *outRids, typename Traits::KeyType *outKeys, char *outIncludes, int maxEntries)
+{
+	typedef typename Traits::LeafNode LeafType;
+	const typename Traits::KeyType &highVal = cursor.scanHighVal<Traits>();
+
+	int count = 0;
+	while (count < maxEntries && cursor.scanExecuting)
+	{
+		// the cursor keeps its current leaf pinned
+		LeafType* leafNode = reinterpret_cast<LeafType*>(cursor.currentPageData);
+		if (cursor.nextEntry >= leafNode->size)
 		{
-			std::cout << nonLeafNode->keyArray[index] << " ";
-			if (judgeKey<int>(nonLeafNode->keyArray[index], BTreeIndex::lowValInt, lowOpParm))
+			// go to right sibling
+			PageId rightPageId = leafNode->rightSibPageNo;
+			if (rightPageId == Page::INVALID_NUMBER)
 			{
-				if (nonLeafNode->keyArray[index] == BTreeIndex::lowValInt) 
-				{
-					index++;
-				}
+				cursor.endOfRange();
 				break;
 			}
+			Page* rightPage;
+			bufMgr->readPage(file, rightPageId, rightPage);
+			cursor.moveTo(rightPageId, rightPage);
+			cursor.nextEntry = 0;
+			advanceLeafReadAhead<Traits>(cursor, reinterpret_cast<LeafType*>(rightPage)->rightSibPageNo);
+			continue;
 		}
-		std::cout << std::endl;
-		if (nonLeafNode->size == 0)
-		{
-			throw NoSuchKeyFoundException();
+
+		// keys only grow from the first entry the scan found, so the low bound holds for the rest
+		// of the leaf and the entries that qualify run up to the first key past the high bound
+		const typename Traits::NodeKey *keys = leafNode->keyArray + cursor.nextEntry;
+		int left = leafNode->size - cursor.nextEntry;
+		int end = cursor.nextEntry + (cursor.highOp == LTE ? Traits::upperBound(keys, left, highVal)
+			: Traits::lowerBound(keys, left, highVal));
+		int stop = std::min(end, cursor.nextEntry + (maxEntries - count));
+		RecordId *rids = leafRids<Traits>(leafNode);
+		if (outIncludes != NULL && includeWidth > 0)
+		{
+			// the columns of consecutive entries are next to each other in the leaf
+			memcpy(outIncludes + (std::size_t)count * includeWidth, leafIncludes(leafNode, cursor.nextEntry),
+				(std::size_t)(stop - cursor.nextEntry) * includeWidth);
 		}
-		// if it is just above the leaf page, then just call traverseLeafPage
-		if (nonLeafNode->level == 1)
+		for (int i = cursor.nextEntry; i < stop; i++)
 		{
-			std::cout << "index: " << index << " leaf traverse" << std::endl;
-			traverseLeafPage(nonLeafNode->pageNoArray[index], lowValParm, lowOpParm);
+			outRids[count] = rids[i];
+			if (outKeys != NULL)
+			{
+				outKeys[count] = Traits::value(leafNode->keyArray[i]);
+			}
+			count++;
 		}
-		else
+		cursor.nextEntry = stop;
+		if (stop == end && end < leafNode->size)
 		{
-			// if it is not above the leaf page, then just call func recrusivly
-			std::cout << "index: " << index << " recursive traverse" << std::endl;
-			traverseLeafPageRecursivly(nonLeafNode->pageNoArray[index], lowValParm, lowOpParm);
+			cursor.endOfRange();
 		}
 	}
-	else if (BTreeIndex::attributeType == DOUBLE)
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::aggregate
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::aggregate(const void *lowValParm,
+						   const Operator lowOpParm,
+						   const void *highValParm,
+						   const Operator highOpParm,
+						   IndexAggregate &out,
+						   void *minKey,
+						   void *maxKey)
+{
+	out.count = 0;
+	out.sum = 0;
+	try
 	{
-		NonLeafNodeDouble *nonLeafNode = reinterpret_cast<NonLeafNodeDouble *>(rootPage);
-		int index;
-		for (index = 0; index < nonLeafNode->size; index++)
-		{
-			if (judgeKey<double>(nonLeafNode->keyArray[index], BTreeIndex::lowValDouble, lowOpParm))
-			{
-				if (nonLeafNode->keyArray[index] == BTreeIndex::lowValDouble) 
-				{
-					index++;
-				}
-				break;
-			}
-		}
-		if (nonLeafNode->size == 0)
+		IndexCursor cursor(*this, lowValParm, lowOpParm, highValParm, highOpParm);
+		if (BTreeIndex::attributeType == INTEGER)
 		{
-			throw NoSuchKeyFoundException();
+			aggregate<IntKeyTraits>(cursor, out, minKey, maxKey);
 		}
-		// if it is just above the leaf page, then just call traverseLeafPage
-		if (nonLeafNode->level == 1)
+		else if (BTreeIndex::attributeType == DOUBLE)
 		{
-			std::cout << "index: " << index << " leaf traverse" << " key: " << nonLeafNode->keyArray[index] << std::endl;
-			traverseLeafPage(nonLeafNode->pageNoArray[index], lowValParm, lowOpParm);
+			aggregate<DoubleKeyTraits>(cursor, out, minKey, maxKey);
 		}
 		else
 		{
-			// if it is not above the leaf page, then just call func recrusivly
-			std::cout << "index: " << index << " recursive traverse" << std::endl;
-			traverseLeafPageRecursivly(nonLeafNode->pageNoArray[index], lowValParm, lowOpParm);
+			aggregate<StringKeyTraits>(cursor, out, minKey, maxKey);
 		}
 	}
-	else if (BTreeIndex::attributeType == STRING)
+	catch (const NoSuchKeyFoundException &e)
 	{
-		NonLeafNodeString *nonLeafNode = reinterpret_cast<NonLeafNodeString *>(rootPage);
-		int index;
-		for (index = 0; index < nonLeafNode->size; index++)
-		{
-			std::cout << std::string(nonLeafNode->keyArray[index], STRINGSIZE) << " " << std::endl;
-			if (judgeKey<std::string>(std::string(nonLeafNode->keyArray[index], STRINGSIZE), BTreeIndex::lowValString, lowOpParm))
-			{
-				if (std::string(nonLeafNode->keyArray[index], STRINGSIZE) == BTreeIndex::lowValString) 
-				{
-					index++;
-				}
-				break;
-			}
-		}
-		if (nonLeafNode->size == 0)
+		// empty range
+	}
+}
+
+template <class Traits>
+void BTreeIndex::aggregate(IndexCursor &cursor, IndexAggregate &out, void *minKey, void *maxKey)
+{
+	typedef typename Traits::KeyType KeyType;
+	RecordId rids[SCAN_BATCH_SIZE];
+	KeyType keys[SCAN_BATCH_SIZE];
+	int n;
+	while ((n = scanNextBatch<Traits>(cursor, rids, keys, NULL, SCAN_BATCH_SIZE)) > 0)
+	{
+		// the keys come in ascending order: the first is the minimum and the last the maximum
+		if (out.count == 0 && minKey != NULL)
 		{
-			throw NoSuchKeyFoundException();
+			*(KeyType *)minKey = keys[0];
 		}
-		// if it is just above the leaf page, then just call traverseLeafPage
-		if (nonLeafNode->level == 1)
+		if (maxKey != NULL)
 		{
-			std::cout << "index: " << index << " leaf traverse" << " key: " << std::string(nonLeafNode->keyArray[index], STRINGSIZE) << std::endl;
-			traverseLeafPage(nonLeafNode->pageNoArray[index], lowValParm, lowOpParm);
+			*(KeyType *)maxKey = keys[n - 1];
 		}
-		else
+		for (int i = 0; i < n; i++)
 		{
-			// if it is not above the leaf page, then just call func recrusivly
-			std::cout << "index: " << index << " recursive traverse" << std::endl;
-			traverseLeafPageRecursivly(nonLeafNode->pageNoArray[index], lowValParm, lowOpParm);
+			out.sum += Traits::number(keys[i]);
 		}
+		out.count += n;
 	}
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeIndex::lookup
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::scanNext(RecordId& outRid) 
+int BTreeIndex::lookup(const void *key, std::vector<RecordId> &outRids)
 {
-	if (BTreeIndex::scanExecuting == false)
+	outRids.clear();
+	if (BTreeIndex::attributeType == INTEGER)
 	{
-		throw ScanNotInitializedException();
+		return lookup<IntKeyTraits>(IntKeyTraits::fromScanParam(key), &outRids);
+	}
+	else if (BTreeIndex::attributeType == DOUBLE)
+	{
+		return lookup<DoubleKeyTraits>(DoubleKeyTraits::fromScanParam(key), &outRids);
+	}
+	else
+	{
+		return lookup<StringKeyTraits>(StringKeyTraits::fromScanParam(key), &outRids);
 	}
+}
 
-	Page* targetPage;
-	PageId targetPageId = BTreeIndex::currentPageNum;
-	bufMgr->readPage(file, targetPageId, targetPage);
-	bufMgr->unPinPage(file, targetPageId, false);
+bool BTreeIndex::contains(const void *key)
+{
 	if (BTreeIndex::attributeType == INTEGER)
 	{
-		LeafNodeInt* leafNode = reinterpret_cast<LeafNodeInt*>(targetPage);
-		int index = BTreeIndex::nextEntry;
-		if (index < leafNode->size)
-		{
-			std::cout << leafNode->keyArray[index] << std::endl;
-			if (judgeKey<int>(leafNode->keyArray[index], BTreeIndex::lowValInt, BTreeIndex::lowOp) && judgeKey<int>(leafNode->keyArray[index], BTreeIndex::highValInt, BTreeIndex::highOp))
-			{
-				outRid = leafNode->ridArray[index];
-				BTreeIndex::nextEntry++;
-				return;
-			} else 
-			{
-				throw IndexScanCompletedException();
-			}
-		} else 
-		{
-			std::cout << "go to right slbling" << std::endl;
-			Page* rightPage;
-			PageId rightPageId = leafNode->rightSibPageNo;
-			if (rightPageId == 0)
-			{
-				throw IndexScanCompletedException();
-			}
-			bufMgr->readPage(file, rightPageId, rightPage);
-			bufMgr->unPinPage(file, rightPageId, false);
-			LeafNodeInt* rightLeafNode = reinterpret_cast<LeafNodeInt*>(rightPage);
-			if (judgeKey<int>(rightLeafNode->keyArray[0], BTreeIndex::lowValInt, BTreeIndex::lowOp) && judgeKey<int>(rightLeafNode->keyArray[0], BTreeIndex::highValInt, BTreeIndex::highOp)) 
-			{
-				outRid = rightLeafNode->ridArray[0];
-				BTreeIndex::nextEntry = 1;
-				BTreeIndex::currentPageNum = rightPageId;
-				return;
-			} else 
-			{
-				throw IndexScanCompletedException();
-			}
-		}
-	} else if (BTreeIndex::attributeType == DOUBLE)
+		return lookup<IntKeyTraits>(IntKeyTraits::fromScanParam(key), NULL) > 0;
+	}
+	else if (BTreeIndex::attributeType == DOUBLE)
 	{
-		LeafNodeDouble* leafNode = reinterpret_cast<LeafNodeDouble*>(targetPage);
-		int index = BTreeIndex::nextEntry;
-		if (index < leafNode->size)
-		{
-			if (judgeKey<double>(leafNode->keyArray[index], BTreeIndex::lowValDouble, BTreeIndex::lowOp) && judgeKey<double>(leafNode->keyArray[index], BTreeIndex::highValDouble, BTreeIndex::highOp))
-			{
-				outRid = leafNode->ridArray[index];
-				BTreeIndex::nextEntry++;
-				return;
-			} else 
-			{
-				throw IndexScanCompletedException();
-			}
-		} else 
-		{
-			std::cout << "read right sibling page: " << std::endl;
-			Page* rightPage;
-			PageId rightPageId = leafNode->rightSibPageNo;
-			if (rightPageId == 0)
-			{
-				throw IndexScanCompletedException();
-			}
-			bufMgr->readPage(file, rightPageId, rightPage);
-			bufMgr->unPinPage(file, rightPageId, false);
-			LeafNodeDouble* rightLeafNode = reinterpret_cast<LeafNodeDouble*>(rightPage);
-			if (rightLeafNode->size == 0)
-			{
-				throw IndexScanCompletedException();
-			}
-			if (judgeKey<double>(rightLeafNode->keyArray[0], BTreeIndex::lowValDouble, BTreeIndex::lowOp) && judgeKey<double>(rightLeafNode->keyArray[0], BTreeIndex::highValDouble, BTreeIndex::highOp)) 
-			{
-				outRid = rightLeafNode->ridArray[0];
-				BTreeIndex::nextEntry = 1;
-				BTreeIndex::currentPageNum = rightPageId;
-				return;
-			} else 
-			{
-				throw IndexScanCompletedException();
-			}
+		return lookup<DoubleKeyTraits>(DoubleKeyTraits::fromScanParam(key), NULL) > 0;
+	}
+	else
+	{
+		return lookup<StringKeyTraits>(StringKeyTraits::fromScanParam(key), NULL) > 0;
+	}
+}
+
+template <class Traits>
+int BTreeIndex::lookup(const typename Traits::KeyType &key, std::vector<RecordId> *outRids)
+{
+	typedef typename Traits::LeafNode LeafType;
+	typedef typename Traits::NonLeafNode NonLeafType;
+
+	// go right of every separator less than the key: a separator equal to the key may have
+	// entries with the key on both of its sides
+	PageId pageNum = BTreeIndex::rootPageNum;
+	if (!isALeafPage())
+	{
+		int level = 0;
+		while (level != 1)
+		{
+			Page *page;
+			bufMgr->readPage(file, pageNum, page);
+			NonLeafType *nonLeafNode = reinterpret_cast<NonLeafType *>(page);
+			level = nonLeafNode->level;
+			PageId childPageNum = nonLeafNode->pageNoArray[Traits::lowerBound(nonLeafNode->keyArray, nonLeafNode->size, key)];
+			bufMgr->unPinPage(file, pageNum, false);
+			pageNum = childPageNum;
 		}
-	} else {
-		LeafNodeString* leafNode = reinterpret_cast<LeafNodeString*>(targetPage);
-		int index = BTreeIndex::nextEntry;
-		if (index < leafNode->size)
-		{
-			if (judgeKey<std::string>(std::string(leafNode->keyArray[index], STRINGSIZE), BTreeIndex::lowValString, BTreeIndex::lowOp) && judgeKey<std::string>(std::string(leafNode->keyArray[index], STRINGSIZE), BTreeIndex::highValString, BTreeIndex::highOp))
-			{
-				outRid = leafNode->ridArray[index];
-				BTreeIndex::nextEntry++;
-				return;
-			} else 
-			{
-				throw IndexScanCompletedException();
-			}
-		} else 
-		{
-			std::cout << "read right sibling page: " << std::endl;
-			Page* rightPage;
-			PageId rightPageId = leafNode->rightSibPageNo;
-			if (rightPageId == 0)
-			{
-				throw IndexScanCompletedException();
-			}
-			bufMgr->readPage(file, rightPageId, rightPage);
-			bufMgr->unPinPage(file, rightPageId, false);
-			LeafNodeString* rightLeafNode = reinterpret_cast<LeafNodeString*>(rightPage);
-			if (rightLeafNode->size == 0)
-			{
-				throw IndexScanCompletedException();
-			}
-			if (judgeKey<std::string>(std::string(rightLeafNode->keyArray[0], STRINGSIZE), BTreeIndex::lowValString, BTreeIndex::lowOp) && judgeKey<std::string>(std::string(rightLeafNode->keyArray[0], STRINGSIZE), BTreeIndex::highValString, BTreeIndex::highOp)) 
-			{
-				outRid = rightLeafNode->ridArray[0];
-				BTreeIndex::nextEntry = 1;
-				BTreeIndex::currentPageNum = rightPageId;
-				return;
-			} else 
+	}
+
+	int found = 0;
+	while (pageNum != Page::INVALID_NUMBER)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNum, page);
+		LeafType *leafNode = reinterpret_cast<LeafType *>(page);
+		RecordId *rids = leafRids<Traits>(leafNode);
+		int i = Traits::lowerBound(leafNode->keyArray, leafNode->size, key);
+		// compare values, so that STRING keys shorter than STRINGSIZE match without their padding
+		for (; i < leafNode->size && Traits::value(leafNode->keyArray[i]) == key; i++)
+		{
+			found++;
+			if (outRids == NULL)
 			{
-				throw IndexScanCompletedException();
+				break;
 			}
+			outRids->push_back(rids[i]);
 		}
+		// the entries with the key can only go on in the next leaf if they reach the end of this one
+		PageId nextPageNum = i == leafNode->size ? leafNode->rightSibPageNo : Page::INVALID_NUMBER;
+		bufMgr->unPinPage(file, pageNum, false);
+		pageNum = nextPageNum;
 	}
+	return found;
 }
 
 // -----------------------------------------------------------------------------
@@ -1414,14 +1373,75 @@ const void BTreeIndex::scanNext(RecordId& outRid)
 //
 const void BTreeIndex::endScan() 
 {
-	if (BTreeIndex::scanExecuting == false)
+	if (scanCursor == NULL)
 	{
 		throw ScanNotInitializedException();
 	}
-	else 
+	delete scanCursor;
+	scanCursor = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor
+// -----------------------------------------------------------------------------
+
+IndexCursor::IndexCursor(BTreeIndex &index,
+						 const void *lowVal,
+						 const Operator lowOp,
+						 const void *highVal,
+						 const Operator highOp)
+	: index(&index), scanExecuting(false), nextEntry(0), currentPageNum(Page::INVALID_NUMBER),
+	  currentPageData(NULL), prefetchParentNum(Page::INVALID_NUMBER), prefetchNextChild(0),
+	  prefetchParentDone(true), leavesAhead(0)
+{
+	index.startScan(*this, lowVal, lowOp, highVal, highOp);
+}
+
+IndexCursor::~IndexCursor()
+{
+	moveTo(Page::INVALID_NUMBER, NULL);
+}
+
+void IndexCursor::moveTo(PageId pageNum, Page *page)
+{
+	if (currentPageData != NULL)
+	{
+		index->bufMgr->unPinPage(index->file, currentPageNum, false);
+	}
+	currentPageNum = pageNum;
+	currentPageData = page;
+}
+
+void IndexCursor::endOfRange()
+{
+	scanExecuting = false;
+	moveTo(Page::INVALID_NUMBER, NULL);
+}
+
+void IndexCursor::scanNext(RecordId &outRid)
+{
+	if (scanNextBatch(&outRid, NULL, 1) == 0)
+	{
+		throw IndexScanCompletedException();
+	}
+}
+
+void IndexCursor::scanNext(RecordId &outRid, void *outKey)
+{
+	if (scanNextBatch(&outRid, outKey, 1) == 0)
 	{
-		BTreeIndex::scanExecuting = false;
+		throw IndexScanCompletedException();
 	}
 }
 
+int IndexCursor::scanNextBatch(RecordId *outRids, void *outKeys, int maxEntries)
+{
+	return index->scanNextBatch(*this, outRids, outKeys, NULL, maxEntries);
+}
+
+int IndexCursor::scanNextBatch(RecordId *outRids, void *outKeys, char *outIncludes, int maxEntries)
+{
+	return index->scanNextBatch(*this, outRids, outKeys, outIncludes, maxEntries);
+}
+
 }
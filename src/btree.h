@@ -17,31 +17,11 @@
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "node_search.h"
 
 namespace badgerdb
 {
 
-/**
- * @brief Datatype enumeration type.
- */
-enum Datatype
-{
-	INTEGER = 0,
-	DOUBLE = 1,
-	STRING = 2
-};
-
-/**
- * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() method.
- */
-enum Operator
-{ 
-	LT, 	/* Less Than */
-	LTE,	/* Less Than or Equal to */
-	GTE,	/* Greater Than or Equal to */
-	GT		/* Greater Than */
-};
-
 /**
  * @brief Size of String key.
  */
@@ -135,6 +115,31 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 		return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief Most INCLUDE columns a covering index stores in its leaves.
+ */
+const int MAX_INCLUDE_COLUMNS = 4;
+
+/**
+ * @brief A fixed-width attribute of the relation stored in every leaf entry of a covering index,
+ * next to the entry's record id, so that queries reading only that attribute skip the relation.
+*/
+struct IncludeColumn{
+  /**
+   * Offset of the attribute inside the record.
+   */
+  int offset;
+
+  /**
+   * Number of bytes of the attribute.
+   */
+  int width;
+
+  bool operator==(const IncludeColumn& rhs) const {
+    return offset == rhs.offset && width == rhs.width;
+  }
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -168,6 +173,12 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
+
+  /**
+   * Number of INCLUDE columns stored in the leaves, and the columns themselves.
+   */
+	int includeCount;
+	IncludeColumn includeColumns[ MAX_INCLUDE_COLUMNS ];
 };
 
 /*
@@ -331,58 +342,199 @@ struct LeafNodeString{
 };
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * @brief Key traits for an index on an INTEGER attribute. A key traits type describes one
+ * attribute type: the node layout, how keys are read from records and stored in node slots,
+ * and how node key arrays are searched. BTreeIndex instantiates its insert, search and scan
+ * code once per traits type, so none of it branches on the attribute type.
 */
-class BTreeIndex {
+struct IntKeyTraits{
+  /**
+   * Type of a key in memory.
+   */
+  typedef int KeyType;
 
- private:
+  /**
+   * Type of one slot of a node's keyArray.
+   */
+  typedef int NodeKey;
+
+  typedef LeafNodeInt LeafNode;
+  typedef NonLeafNodeInt NonLeafNode;
+
+  static const Datatype TYPE = INTEGER;
+  static const int LEAF_SIZE = INTARRAYLEAFSIZE;
+  static const int NONLEAF_SIZE = INTARRAYNONLEAFSIZE;
 
   /**
-   * File object for the index file.
+   * Key passed to insertEntry, a pointer to an int.
    */
-	File		*file;
+  static KeyType fromInsertParam(const void *key) { return *(const int *)key; }
 
   /**
-   * Buffer Manager Instance.
+   * Scan bound passed to startScan, a pointer to an int.
    */
-	BufMgr	*bufMgr;
+  static KeyType fromScanParam(const void *value) { return *(const int *)value; }
 
   /**
-   * Page number of meta page.
+   * Key stored in the record bytes starting at `record`; `length` bytes of the record are left.
    */
-	PageId	headerPageNum;
+  static void extract(const char *record, std::size_t length, KeyType &key) { memcpy(&key, record, sizeof(int)); }
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * Key in a node slot as compared by the index (load) and as handed back to callers (value).
    */
-	PageId	rootPageNum;
+  static KeyType load(const NodeKey &nodeKey) { return nodeKey; }
+  static KeyType value(const NodeKey &nodeKey) { return nodeKey; }
+  static void store(NodeKey &nodeKey, const KeyType &key) { nodeKey = key; }
 
   /**
-   * Datatype of attribute over which index is built.
+   * Key as a number for SUM aggregates; 0 for keys that are not numbers.
    */
-	Datatype	attributeType;
+  static double number(const KeyType &key) { return key; }
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Number of keys less than (lowerBound) or not greater than (upperBound) the key.
    */
-	int 		attrByteOffset;
+  static int lowerBound(const NodeKey *keys, int size, const KeyType &key) { return keyLowerBound(keys, size, key); }
+  static int upperBound(const NodeKey *keys, int size, const KeyType &key) { return keyUpperBound(keys, size, key); }
+};
+
+/**
+ * @brief Key traits for an index on a DOUBLE attribute.
+*/
+struct DoubleKeyTraits{
+  typedef double KeyType;
+  typedef double NodeKey;
+  typedef LeafNodeDouble LeafNode;
+  typedef NonLeafNodeDouble NonLeafNode;
+
+  static const Datatype TYPE = DOUBLE;
+  static const int LEAF_SIZE = DOUBLEARRAYLEAFSIZE;
+  static const int NONLEAF_SIZE = DOUBLEARRAYNONLEAFSIZE;
+
+  static KeyType fromInsertParam(const void *key) { return *(const double *)key; }
+  static KeyType fromScanParam(const void *value) { return *(const double *)value; }
+  static void extract(const char *record, std::size_t length, KeyType &key) { memcpy(&key, record, sizeof(double)); }
+
+  static KeyType load(const NodeKey &nodeKey) { return nodeKey; }
+  static KeyType value(const NodeKey &nodeKey) { return nodeKey; }
+  static void store(NodeKey &nodeKey, const KeyType &key) { nodeKey = key; }
+  static double number(const KeyType &key) { return key; }
+
+  static int lowerBound(const NodeKey *keys, int size, const KeyType &key) { return keyLowerBound(keys, size, key); }
+  static int upperBound(const NodeKey *keys, int size, const KeyType &key) { return keyUpperBound(keys, size, key); }
+};
+
+/**
+ * @brief Key traits for an index on a STRING attribute. Keys are the first STRINGSIZE chars of
+ * the attribute, stored without a terminating NUL and compared as std::string(slot, STRINGSIZE).
+*/
+struct StringKeyTraits{
+  typedef std::string KeyType;
+  typedef char NodeKey[ STRINGSIZE ];
+  typedef LeafNodeString LeafNode;
+  typedef NonLeafNodeString NonLeafNode;
+
+  static const Datatype TYPE = STRING;
+  static const int LEAF_SIZE = STRINGARRAYLEAFSIZE;
+  static const int NONLEAF_SIZE = STRINGARRAYNONLEAFSIZE;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Key passed to insertEntry, a pointer to a std::string.
    */
-	int			leafOccupancy;
+  static KeyType fromInsertParam(const void *key) { return *(const std::string *)key; }
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Scan bound passed to startScan, a pointer to a NUL-terminated char string.
    */
-	int			nodeOccupancy;
+  static KeyType fromScanParam(const void *value) { return std::string((const char *)value).substr(0, STRINGSIZE); }
+
+  // records are not NUL-terminated in the page
+  static void extract(const char *record, std::size_t length, KeyType &key)
+  {
+    key.assign(record, strnlen(record, length < (std::size_t)STRINGSIZE ? length : STRINGSIZE));
+  }
+
+  // callers get the key without the NUL padding of shorter keys
+  static KeyType load(const NodeKey &nodeKey) { return std::string(nodeKey, STRINGSIZE); }
+  static KeyType value(const NodeKey &nodeKey) { return std::string(nodeKey, strnlen(nodeKey, STRINGSIZE)); }
+  static void store(NodeKey &nodeKey, const KeyType &key) { strncpy(nodeKey, key.c_str(), STRINGSIZE); }
+  static double number(const KeyType &key) { return 0; }
+
+  static int lowerBound(const NodeKey *keys, int size, const KeyType &key) { return keyLowerBound(keys[0], STRINGSIZE, size, key); }
+  static int upperBound(const NodeKey *keys, int size, const KeyType &key) { return keyUpperBound(keys[0], STRINGSIZE, size, key); }
+};
+
+/**
+ * @brief Default number of bytes of <key, rid> pairs kept in memory while sorting the relation for an index build.
+ */
+const std::size_t DEFAULT_SORT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+template <class T>
+class ExternalSorter;
+
+/**
+ * @brief Tunables used when BTreeIndex builds a new index file from its base relation.
+*/
+struct BTreeBuildOptions{
+  /**
+   * Fraction of every leaf and non-leaf page that the bulk loader fills, in (0, 1].
+   * Leaving some room in each page makes later insertions split less often.
+   */
+  double fillFactor;
+
+  /**
+   * Number of bytes of <key, rid> pairs sorted in memory. Larger relations are sorted
+   * externally, spilling sorted runs into temporary files next to the index file.
+   */
+  std::size_t sortMemoryBudget;
+
+  /**
+   * Attributes stored in every leaf entry next to its record id, at most MAX_INCLUDE_COLUMNS.
+   * Leaves hold fewer entries the wider the columns are. Empty for a plain index.
+   */
+  std::vector<IncludeColumn> includeColumns;
+
+  BTreeBuildOptions()
+    : fillFactor(1.0), sortMemoryBudget(DEFAULT_SORT_MEMORY_BUDGET)
+  {
+  }
+};
+
+/**
+ * @brief COUNT and SUM over the keys of an index range, see BTreeIndex::aggregate.
+*/
+struct IndexAggregate{
+  /**
+   * Number of entries in the range.
+   */
+  long count;
+
+  /**
+   * Sum of their keys; 0 for STRING keys.
+   */
+  double sum;
+};
 
+class BTreeIndex;
 
-	// MEMBERS SPECIFIC TO SCANNING
+/**
+ * @brief An index scan over one BTreeIndex. A cursor owns its scan state, its scan range and
+ * the pin on the leaf it is positioned on, so any number of cursors can scan the same index at
+ * the same time, from one thread or several, as long as nothing is inserted into the index
+ * meanwhile. Every cursor must be destroyed before its index.
+*/
+class IndexCursor {
+
+ private:
+
+  /**
+   * Index being scanned.
+   */
+	BTreeIndex	*index;
 
   /**
-   * True if an index scan has been started.
+   * True while the cursor has entries left; false once it reached the end of the range.
    */
 	bool		scanExecuting;
 
@@ -397,7 +549,7 @@ class BTreeIndex {
 	PageId	currentPageNum;
 
   /**
-   * Current Page being scanned.
+   * Current Page being scanned, pinned in the buffer pool while the cursor is positioned on it.
    */
 	Page		*currentPageData;
 
@@ -442,9 +594,205 @@ class BTreeIndex {
 	Operator	highOp;
 
   /**
-   * a boolean to mark the time a non leaf node is full
-  */
-  int fullTime;
+   * Non-leaf node above the leaves the scan started in, used to find the leaves to read ahead.
+   * Page::INVALID_NUMBER when the root is a leaf.
+   */
+  PageId prefetchParentNum;
+
+  /**
+   * Index in prefetchParentNum's pageNoArray of the next leaf to read ahead.
+   */
+  int prefetchNextChild;
+
+  /**
+   * True once every leaf below prefetchParentNum has been requested.
+   */
+  bool prefetchParentDone;
+
+  /**
+   * Number of leaves after the current one already requested.
+   */
+  std::uint32_t leavesAhead;
+
+  /**
+   * Low and high bound of the scan, in the members of the index's key type.
+   */
+  template <class Traits>
+  typename Traits::KeyType &scanLowVal();
+  template <class Traits>
+  typename Traits::KeyType &scanHighVal();
+
+  /**
+   * Move the pin from the current leaf to another one, or drop it when pageNum is Page::INVALID_NUMBER.
+   */
+  void moveTo(PageId pageNum, Page *page);
+
+  /**
+   * The scan passed the end of its range: unpin the current leaf.
+   */
+  void endOfRange();
+
+  // cursors hold a pin and cannot be copied
+  IndexCursor(const IndexCursor &);
+  IndexCursor &operator=(const IndexCursor &);
+
+  friend class BTreeIndex;
+
+ public:
+
+  /**
+	 * Begin a filtered scan of the index, see BTreeIndex::startScan.
+   * @param index		Index to scan
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   */
+	IndexCursor(BTreeIndex &index, const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+   * Unpin the leaf the cursor is positioned on, if any.
+   */
+	~IndexCursor();
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+   */
+	void scanNext(RecordId& outRid);
+
+  /**
+   * Fetch the record id and the key of the next index entry that matches the scan; the key
+   * comes from the leaf, so index-only queries never read the relation.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey	Key of the entry, pointer to an int / double / std::string depending on the type of the index
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+   */
+	void scanNext(RecordId& outRid, void *outKey);
+
+  /**
+   * Fetch the next entries that match the scan, following rightSibPageNo from leaf to leaf until
+   * outRids is full or the range ends. The end of the range is not an error: the call returns
+   * fewer entries than asked for, and 0 once nothing is left.
+   * @param outRids		Receives the record ids, room for maxEntries
+   * @param outKeys		NULL, or receives the keys: an array of maxEntries int / double / std::string
+   *									depending on the type of the index
+   * @param maxEntries	Most entries to return, at least 1
+   * @return number of entries returned, 0 at the end of the range
+	 * @throws BadScanParamException If maxEntries is not positive
+   */
+	int scanNextBatch(RecordId *outRids, void *outKeys, int maxEntries);
+
+  /**
+   * Like scanNextBatch above, also copying the INCLUDE columns of every entry from the leaves.
+   * @param outRids		Receives the record ids, room for maxEntries
+   * @param outKeys		NULL, or receives the keys like above
+   * @param outIncludes	NULL, or receives maxEntries * BTreeIndex::getIncludeWidth() bytes: the
+   *									INCLUDE columns of each entry one after the other, in the order of
+   *									BTreeBuildOptions::includeColumns
+   * @param maxEntries	Most entries to return, at least 1
+   * @return number of entries returned, 0 at the end of the range
+	 * @throws BadScanParamException If maxEntries is not positive
+   */
+	int scanNextBatch(RecordId *outRids, void *outKeys, char *outIncludes, int maxEntries);
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. startScan/scanNext/endScan run one scan at a time; IndexCursor runs any number of them.
+*/
+class BTreeIndex {
+
+  friend class IndexCursor;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+	PageId	rootPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+	int			leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+
+  /**
+   * Cursor of the scan run through startScan/scanNext/endScan, NULL when none is running.
+   */
+	IndexCursor *scanCursor;
+
+  /**
+   * Fraction of each page filled by the bulk loader when the index is built.
+   */
+  double fillFactor;
+
+  /**
+   * Number of bytes of <key, rid> pairs sorted in memory when the index is built.
+   */
+  std::size_t sortMemoryBudget;
+
+  /**
+   * Number of leaves a scan asks the buffer manager to read ahead of the current leaf.
+   */
+  std::uint32_t prefetchWindow;
+
+  /**
+   * INCLUDE columns stored in every leaf entry, and their total width in bytes.
+   */
+  std::vector<IncludeColumn> includeColumns;
+  int includeWidth;
+
+  /**
+   * Byte offsets inside a leaf page of its ridArray and of the INCLUDE columns of its entries.
+   * Without INCLUDE columns the rids are the leaf struct's ridArray; with them the leaf holds
+   * leafOccupancy keys, then leafOccupancy rids, then the columns of each entry.
+   */
+  std::size_t leafRidOffset;
+  std::size_t leafIncludeOffset;
+
+  /**
+   * Page numbers of the right edge of the tree, from the root down to the rightmost leaf, used
+   * to append keys that sort after every key in the index without descending from the root.
+   * Empty until the first insert, and emptied when an insert elsewhere splits a node on it or
+   * gives one of its nodes a new last child.
+   */
+  std::vector<PageId> rightmostPath;
 
 	
  public:
@@ -459,10 +807,14 @@ class BTreeIndex {
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param options						Tunables for building a new index. When an existing index file is opened only
+   *														includeColumns is looked at: if not empty it must equal the columns the
+   *														index was built with, if empty those columns are used.
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters, or options.includeColumns differs from the columns stored in the metapage.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const BTreeBuildOptions &options = BTreeBuildOptions());
 	
 
   /**
@@ -486,6 +838,15 @@ class BTreeIndex {
 	const void insertEntry(const void* key, const RecordId rid);
 
 
+  /**
+	 * Insert a new entry into a covering index, copying its INCLUDE columns from the record.
+   * @param key			Key to insert, pointer to integer/double/char string
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @param record		The record's bytes
+	**/
+	const void insertEntry(const void* key, const RecordId rid, const std::string &record);
+
+
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
 	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
@@ -514,6 +875,77 @@ class BTreeIndex {
 	const void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the next entries of the scan started by startScan, see IndexCursor::scanNextBatch.
+   * @param outRids		Receives the record ids, room for maxEntries
+   * @param outKeys		NULL, or an array of maxEntries keys of the index's type
+   * @param maxEntries	Most entries to return, at least 1
+   * @return number of entries returned, 0 at the end of the range
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws BadScanParamException If maxEntries is not positive
+	**/
+	int scanNextBatch(RecordId *outRids, void *outKeys, int maxEntries);
+
+
+  /**
+	 * Fetch the next entries of the scan started by startScan with their INCLUDE columns, see
+	 * IndexCursor::scanNextBatch.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws BadScanParamException If maxEntries is not positive
+	**/
+	int scanNextBatch(RecordId *outRids, void *outKeys, char *outIncludes, int maxEntries);
+
+
+  /**
+   * Number of bytes of the INCLUDE columns of one entry, 0 for a plain index.
+   */
+	int getIncludeWidth() const;
+
+
+  /**
+   * Compute COUNT, SUM, MIN and MAX over the keys in a range from the leaves alone, without
+   * touching the relation. The range is given as for startScan; an empty range gives a count of 0
+   * and leaves minKey and maxKey alone.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param out			Receives the count and the sum
+   * @param minKey	NULL, or receives the smallest key: pointer to an int / double / std::string
+   * @param maxKey	NULL, or receives the largest key, like minKey
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+   */
+	void aggregate(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+						IndexAggregate &out, void *minKey = NULL, void *maxKey = NULL);
+
+
+  /**
+   * Find every entry with the given key with one descent from the root, binary searching each
+   * node. No scan is started, so lookups can run while scans and cursors are open. Entries with
+   * the key that run on into the next leaves are followed along rightSibPageNo.
+   * @param key			Key to look up, pointer to integer / double / char string
+   * @param outRids	Receives the record ids of the entries with that key, in index order
+   * @return number of entries found, 0 if the key is not in the index
+   */
+	int lookup(const void* key, std::vector<RecordId> &outRids);
+
+
+  /**
+   * True if the index has an entry with the given key; stops at the first one, see lookup.
+   * @param key			Key to look up, pointer to integer / double / char string
+   */
+	bool contains(const void* key);
+
+
+  /**
+   * Set the number of leaves scans ask the buffer manager to read ahead; 0 turns read-ahead off.
+   * Defaults to DEFAULT_PREFETCH_WINDOW.
+   * @param pages		Read-ahead window in leaf pages
+   */
+	void setPrefetchWindow(std::uint32_t pages);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
@@ -529,139 +961,339 @@ class BTreeIndex {
    **/
   const void InitializeBTreeIndex(BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType);
 
+  /**
+   * @brief
+   * set the INCLUDE columns and lay out the leaves for them
+   * @param columns
+   * @throws  BadIndexInfoException If there are too many columns or they do not fit in a leaf
+   */
+  void setIncludeColumns(const std::vector<IncludeColumn> &columns);
+
+  /**
+   * @brief
+   * compute leafOccupancy, leafRidOffset and leafIncludeOffset for includeWidth bytes per entry
+   */
+  template <class Traits>
+  void layOutLeaves();
+
+  /**
+   * @brief
+   * record ids of a leaf
+   * @param leafNode
+   */
+  template <class Traits>
+  RecordId *leafRids(typename Traits::LeafNode *leafNode);
+
+  /**
+   * @brief
+   * INCLUDE columns of the entry in slot `position` of a leaf
+   * @param leafNode
+   * @param position
+   */
+  char *leafIncludes(void *leafNode, int position);
+
+  /**
+   * @brief
+   * copy the INCLUDE columns of a record into includeWidth bytes at dst; bytes past the end of
+   * the record are zero
+   * @param record
+   * @param length
+   * @param dst
+   */
+  void extractIncludes(const char *record, std::size_t length, char *dst);
+
+  /**
+   * @brief
+   * store the record id and the INCLUDE columns of the entry in slot `position` of a leaf
+   * @param leafNode
+   * @param position
+   * @param rid
+   * @param includes      includeWidth bytes, NULL for a plain index
+   */
+  template <class Traits>
+  void storeLeafEntry(typename Traits::LeafNode *leafNode, int position, const RecordId rid, const char *includes);
+
   /**
    * @brief 
-   * build a B+ Tree using fileScan class
+   * build a B+ Tree using fileScan class: feed every <key, rid> pair of the relation to an
+   * ExternalSorter, then stream the sorted pairs into the bulk loader
    * @param relationName 
-   * @param bufMgrIn 
    * @param BTreeMetaData
    **/
-  template <class T>
+  template <class Traits>
   void buildBTree(const std::string &relationName, IndexMetaInfo &BTreeMetaData);
 
   /**
-   * @brief 
-   * split leaf node
-   * @param rootPageNum
+   * @brief
+   * build the tree bottom-up from pairs already sorted by key: pack the pairs into leaf pages
+   * up to fillFactor, chain the leaves through rightSibPageNo, then build each non-leaf level
+   * from the level below it until a single root remains. Updates rootPageNum and the metadata.
+   * @param entries       sorter returning the <key, rid> pairs in ascending order
+   * @param BTreeMetaData
+   */
+  template <class Traits>
+  void bulkLoad(ExternalSorter<typename Traits::KeyType> &entries, IndexMetaInfo &BTreeMetaData);
+
+  /**
+   * @brief
+   * build one non-leaf level on top of the given level
+   * @param children      page number and smallest key of every node of the level below, left to right
+   * @param level         level value stored in the new nodes (1 if children are leaves, 0 otherwise)
+   * @return page number and smallest key of every node of the new level
+   */
+  template <class Traits>
+  std::vector<PageKeyPair<typename Traits::KeyType>> bulkLoadNonLeafLevel(const std::vector<PageKeyPair<typename Traits::KeyType>> &children, int level);
+
+  /**
+   * @brief
+   * start reading ahead the leaves to the right of the one a scan starts in
+   * @param cursor          scan reading ahead
+   * @param parentPageNum   non-leaf node on level 1 the scan descended through
+   * @param childIndex      index in its pageNoArray of the leaf the scan starts in
+   */
+  template <class Traits>
+  void startLeafReadAhead(IndexCursor &cursor, PageId parentPageNum, int childIndex);
+
+  /**
+   * @brief
+   * the scan moved to the next leaf: keep the read-ahead window full, from the parent's
+   * pageNoArray while it has leaves left, then one leaf ahead along rightSibPageNo
+   * @param cursor          scan reading ahead
+   * @param nextSibPageNo   right sibling of the leaf the scan moved to
+   */
+  template <class Traits>
+  void advanceLeafReadAhead(IndexCursor &cursor, PageId nextSibPageNo);
+
+  /**
+   * @brief
+   * request leaves from the parent's pageNoArray until the window is full
+   * @param cursor          scan reading ahead
+   */
+  template <class Traits>
+  void readAheadLeaves(IndexCursor &cursor);
+
+  /**
+   * @brief
+   * insert a key into the tree, the typed body of insertEntry
    * @param key
    * @param rid
+   * @param includes      INCLUDE columns of the entry, NULL for a plain index
    */
-  template <class T, class LeafType, class NonLeafType>
-  void splitLeafPage(PageId &rootPageNum, const void* key, const RecordId rid);
+  template <class Traits>
+  void insertKey(const typename Traits::KeyType &key, const RecordId rid, const char *includes);
 
   /**
    * @brief
-   * insert key into leaf node, without updating the size attribute in struct 
-   * @param pageId
-   * @param position
+   * insert the key into the rightmost leaf if it sorts after every key in the index. A full
+   * leaf is split 100/0: it stays full and the key starts a new rightmost leaf.
    * @param key
+   * @param rid
+   * @param includes
+   * @return false, leaving the tree alone, if the key is less than the largest key
+   */
+  template <class Traits>
+  bool appendKey(const typename Traits::KeyType &key, const RecordId rid, const char *includes);
+
+  /**
+   * @brief
+   * add a node as the new rightmost child of the node at `depth - 1` of rightmostPath, splitting
+   * full nodes up to the root and growing a new root when the root itself is full
+   * @param depth         depth in rightmostPath of the new node
+   * @param key           smallest key reachable through the new node
+   * @param childPageNum  the new node
+   */
+  template <class Traits>
+  void appendChild(std::size_t depth, const typename Traits::KeyType &key, PageId childPageNum);
+
+  /**
+   * @brief
+   * fill rightmostPath by following the last child of every node from the root
+   */
+  template <class Traits>
+  void findRightmostPath();
+
+  /**
+   * @brief
+   * forget rightmostPath if the node is on it; called by the inserts that do not go through
+   * appendKey when they split the node
+   * @param pageNum       the node
+   */
+  void rightEdgeChanged(PageId pageNum);
+
+  /**
+   * @brief
+   * move entries of a leaf, with their record ids and INCLUDE columns, within a leaf or to another one
+   * @param src           leaf the entries are in
+   * @param from          position of the first entry in src
+   * @param dst           leaf the entries go to, may be src
+   * @param to            position of the first entry in dst
+   * @param count         number of entries
    */
-  void insertDataLeaf(PageId pageId, int position, const void *key);
+  template <class Traits>
+  void moveLeafEntries(typename Traits::LeafNode *src, int from, typename Traits::LeafNode *dst, int to, int count);
 
   /**
    * @brief
-   * insert key into nonleaf node, without updating the size attribute in struct
-   * @param pageId
+   * insert an entry into a leaf with room for it, shifting the entries from the position on
+   * @param leafNode
    * @param position
    * @param key
+   * @param rid
+   * @param includes
    */
-  void insertDataNonLeaf(PageId pageId, int position, const void *key);
+  template <class Traits>
+  void insertIntoLeaf(typename Traits::LeafNode *leafNode, int position, const typename Traits::KeyType &key, const RecordId rid, const char *includes);
 
   /**
    * @brief
-   * insert string key into nonleaf node, without updating the size attribute in struct
-   * @param pageId
-   * @param position
-   * @param keyPageId
-   * @param keyPagePosition
+   * insert a key and the child right of it into a non-leaf node with room for them, shifting the
+   * keys from the position on and the children after it
+   * @param nonLeafNode
+   * @param position      position of the key; the child goes to position + 1
+   * @param key           smallest key reachable through the child
+   * @param childPageNum
    */
-  template <class Type1, class Type2>
-  void insertDataAnyTypeString(PageId pageId, int position, PageId keyPageId, int keyPagePosition);
+  template <class Traits>
+  void insertIntoNonLeaf(typename Traits::NonLeafNode *nonLeafNode, int position, const typename Traits::KeyType &key, PageId childPageNum);
 
   /**
    * @brief
-   * travese and locate the position to insert the key
-   * @param rootPageNum
+   * insert the entry into the leaf, keeping its keys sorted; a full leaf is split in half
+   * @param leafPageNum
    * @param key
    * @param rid
+   * @param includes
+   * @param splitKey      set to the first key of the new right sibling if the leaf was split
+   * @param splitPageNum  set to the new right sibling if the leaf was split
+   * @return true if the leaf was split and the parent needs to add splitPageNum
    */
-  template <class T, class LeafType, class NonLeafType>
-  void traverseNode(PageId &rootPageNum, const void *key, RecordId rid);
+  template <class Traits>
+  bool insertLeafEntry(PageId leafPageNum, const typename Traits::KeyType &key, const RecordId rid, const char *includes,
+                       typename Traits::KeyType &splitKey, PageId &splitPageNum);
 
   /**
    * @brief
-   * compare the key to see which one is larger
-   * @param nodeKey
+   * insert the entry into the subtree under a non-leaf node, adding the children its splits create;
+   * a full node is split in half and its middle key moves up
+   * @param pageNum       the non-leaf node
    * @param key
+   * @param rid
+   * @param includes
+   * @param splitKey      set to the key that moves up if the node was split
+   * @param splitPageNum  set to the new right sibling if the node was split
+   * @return true if the node was split and its parent needs to add splitPageNum
    */
-  bool compareKey(void* nodeKey, const void* key);
+  template <class Traits>
+  bool traverseNode(PageId pageNum, const typename Traits::KeyType &key, const RecordId rid, const char *includes,
+                    typename Traits::KeyType &splitKey, PageId &splitPageNum);
 
   /**
    * @brief
-   * compare the key to see which one is larger
-   * @param pageId
-   * @param key
+   * put a new root above the root and the right sibling its split created
+   * @param splitKey      smallest key reachable through the sibling
+   * @param splitPageNum  the sibling
    */
-  bool compareNonLeafKey(PageId pageId, int index, const void* key);
+  template <class Traits>
+  void growRoot(const typename Traits::KeyType &splitKey, PageId splitPageNum);
 
   /**
    * @brief
    * check to see if the leaf node is filled
    * @param size
    */
+  template <class Traits>
   bool whetherLeafIsFull(int size);
 
+    /**
+   * @brief
+   * check whether it is a leaf page or not
+   */
+  bool isALeafPage();
+
   /**
    * @brief
-   * check to see if the non leaf node is filled
-   * @param pageId
+   * check the scan parameters, set up the cursor's scan state and position it on the first entry
+   * @param cursor
+   * @param lowValParm
+   * @param lowOpParm
+   * @param highValParm
+   * @param highOpParm
    */
-  bool whetherNonLeafIsFull(PageId pageId);
+  void startScan(IndexCursor &cursor, const void *lowValParm, const Operator lowOpParm, const void *highValParm, const Operator highOpParm);
 
   /**
    * @brief
-   * split leaf page and update root page
-   * @param rootPageNum
-   * @param leafPageId
-   * @param key
-   * @param rid
+   * the typed body of startScan(cursor, ...)
+   * @param cursor
+   * @param lowValParm
+   * @param highValParm
    */
-  template <class T, class LeafType, class NonLeafType>
-  void splitLeafPageAndInsertEntry(PageId&rootPageNum, PageId leafPageId, const void *key, const RecordId rid);
+  template <class Traits>
+  void startScan(IndexCursor &cursor, const void *lowValParm, const void *highValParm);
 
-    /**
+  /**
    * @brief
-   * check whether it is a leaf page or not
+   * fetch the next entries of the cursor's scan
+   * @param cursor
+   * @param outRids
+   * @param outKeys
+   * @param outIncludes
+   * @param maxEntries
    */
-  bool isALeafPage();
+  int scanNextBatch(IndexCursor &cursor, RecordId *outRids, void *outKeys, char *outIncludes, int maxEntries);
+
+  /**
+   * @brief
+   * the typed body of scanNextBatch(cursor, ...)
+   * @param cursor
+   * @param outRids
+   * @param outKeys
+   * @param outIncludes
+   * @param maxEntries
+   */
+  template <class Traits>
+  int scanNextBatch(IndexCursor &cursor, RecordId *outRids, typename Traits::KeyType *outKeys, char *outIncludes, int maxEntries);
 
   /**
    * @brief
-   * whether the key is greater or less than ValParm
-   * return true if key is greater; false if key is less
+   * the typed body of aggregate: fold the cursor's entries into out, minKey and maxKey
+   * @param cursor
+   * @param out
+   * @param minKey
+   * @param maxKey
+   */
+  template <class Traits>
+  void aggregate(IndexCursor &cursor, IndexAggregate &out, void *minKey, void *maxKey);
+
+  /**
+   * @brief
+   * the typed body of lookup and contains: descend to the leftmost leaf that may hold the key
+   * and collect the record ids of the entries with that key
    * @param key
-   * @param ValParm
-   * @param OpParm
+   * @param outRids       receives the record ids; NULL to stop at the first entry found
+   * @return number of entries found
    */
-  template <class T>
-  bool judgeKey(T key, T ValParm, const Operator OpParm);
+  template <class Traits>
+  int lookup(const typename Traits::KeyType &key, std::vector<RecordId> *outRids);
 
   /**
    * @brief
    * traverse through leaf page
+   * @param cursor
    * @param rootPageNum
-   * @param ValParm
    * @param OpParm
    */
-  void traverseLeafPage(PageId rootPageNum, const void *ValParm, const Operator OpParm);
+  template <class Traits>
+  void traverseLeafPage(IndexCursor &cursor, PageId rootPageNum, const Operator OpParm);
 
   /**
    * @brief
    * the node is not a leaf page, traverse recursivly and find the leaf page that we want
+   * @param cursor
    * @param rootPageNum
-   * @param ValParm
    * @param OpParm
    */
-  void traverseLeafPageRecursivly(PageId rootPageNum, const void *ValParm, const Operator OpParm);
+  template <class Traits>
+  void traverseLeafPageRecursivly(IndexCursor &cursor, PageId rootPageNum, const Operator OpParm);
 };
 }
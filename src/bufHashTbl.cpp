@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <iostream>
+#include <cstdint>
 #include "buffer.h"
 #include "bufHashTbl.h"
 #include "exceptions/hash_already_present_exception.h"
@@ -15,100 +16,104 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+std::uint32_t BufHashTbl::hash(const File* file, const PageId pageNo) const
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // combine the file pointer with the page number and run the result through the
+  // 64-bit finalizer of MurmurHash3, so neighbouring pages of a file and files
+  // allocated at nearby addresses spread over the whole table
+  std::uint64_t value = (std::uint64_t)(std::uintptr_t)file * 0x9e3779b97f4a7c15ULL;
+  value ^= pageNo;
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return (std::uint32_t)value & mask;
 }
 
-BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+BufHashTbl::BufHashTbl(const std::uint32_t maxEntries)
+	: numEntries(0)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  // keep the table at most half full
+  HTSIZE = 16;
+  while (HTSIZE < 2 * maxEntries)
+    HTSIZE *= 2;
+  mask = HTSIZE - 1;
+
+  ht = new hashBucket[HTSIZE];
+  for(std::uint32_t i = 0; i < HTSIZE; i++)
+    ht[i].file = NULL;
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
-  }
   delete [] ht;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+std::uint32_t BufHashTbl::findSlot(const File* file, const PageId pageNo) const
 {
-  int index = hash(file, pageNo);
+  for (std::uint32_t index = hash(file, pageNo); ht[index].file != NULL; index = (index + 1) & mask)
+  {
+    if (ht[index].file == file && ht[index].pageNo == pageNo)
+      return index;
+  }
+  return HTSIZE;
+}
 
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  std::uint32_t index = hash(file, pageNo);
+  while (ht[index].file != NULL) {
+    if (ht[index].file == file && ht[index].pageNo == pageNo)
+  		throw HashAlreadyPresentException(ht[index].file->filename(), ht[index].pageNo, ht[index].frameNo);
+    index = (index + 1) & mask;
   }
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
+  if (numEntries >= HTSIZE / 2)
   	throw HashTableException();
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  ht[index].file = (File*) file;
+  ht[index].pageNo = pageNo;
+  ht[index].frameNo = frameNo;
+  numEntries++;
 }
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
+  if (!find(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufHashTbl::find(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  std::uint32_t index = findSlot(file, pageNo);
+  if (index == HTSIZE)
+    return false;
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  frameNo = ht[index].frameNo; // return frameNo by reference
+  return true;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+  std::uint32_t hole = findSlot(file, pageNo);
+  if (hole == HTSIZE)
+    throw HashNotFoundException(file->filename(), pageNo);
 
-  while (tmpBuc)
+  // shift back every following entry of the probe run that may legally occupy
+  // the hole, i.e. whose home slot is not cyclically between the hole and itself
+  for (std::uint32_t index = (hole + 1) & mask; ht[index].file != NULL; index = (index + 1) & mask)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
-
-      delete tmpBuc;
-      return;
-    }
-		else
+    std::uint32_t home = hash(ht[index].file, ht[index].pageNo);
+    if (((index - home) & mask) >= ((index - hole) & mask))
 		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+      ht[hole] = ht[index];
+      hole = index;
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  ht[hole].file = NULL;
+  numEntries--;
 }
 
 }
@@ -12,11 +12,11 @@
 namespace badgerdb {
 
 /**
-* @brief Declarations for buffer pool hash table
+* @brief One slot of the buffer pool hash table
 */
 struct hashBucket {
 	/**
-	 * pointer a file object (more on this below)
+	 * pointer a file object (more on this below); NULL if the slot is empty
 	 */
 	File *file;
 
@@ -29,30 +29,41 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* The table uses open addressing with linear probing over an array of slots allocated once by
+* the constructor, so inserts and removals never allocate memory. The table is kept at most half
+* full; a lookup usually touches a single 16 byte slot and stops at the first empty slot.
+* Removal shifts the following entries of the probe sequence back instead of leaving tombstones.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 *	Number of slots in the table, always a power of two
+	 */
+  std::uint32_t HTSIZE;
+
+	/**
+	 *	HTSIZE - 1, used to wrap slot numbers around the table
+	 */
+  std::uint32_t mask;
+
+	/**
+	 *	Number of entries in the table
 	 */
-  int HTSIZE;
+  std::uint32_t numEntries;
+
 	/**
 	 * Actual Hash table object
 	 */
-  hashBucket**  ht;
+  hashBucket*  ht;
 
 	/**
 	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
@@ -61,13 +72,24 @@ class BufHashTbl
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  std::uint32_t hash(const File* file, const PageId pageNo) const;
+
+	/**
+	 * returns the slot holding (file, pageNo), or HTSIZE if it is not in the table
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Slot number.
+	 */
+  std::uint32_t findSlot(const File* file, const PageId pageNo) const;
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param maxEntries	Largest number of entries the table will hold, i.e. the number of buffer frames
 	 */
-	BufHashTbl(const int htSize);  // constructor
+	BufHashTbl(const std::uint32_t maxEntries);  // constructor
 
 	/**
    * Destructor of BufHashTbl class
@@ -81,7 +103,7 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException if the table already holds as many entries as it was sized for
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
@@ -96,6 +118,17 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool without throwing.
+   * Use this where a missing entry is an expected outcome, such as a buffer miss.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set if the entry is found
+   * @return  			True if the page entry is in the hash table.
+	 */
+  bool find(const File* file, const PageId pageNo, FrameId &frameNo);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
@@ -6,25 +6,32 @@
  */
 
 #include <memory>
+#include <cassert>
 #include <iostream>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
 #include "buffer.h"
+#include "replacement_policy.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
 
-namespace badgerdb { 
+namespace badgerdb {
 
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+BufMgr::BufMgr(std::uint32_t bufs, std::uint32_t numParts, ReplacementPolicyType policy)
+	: numBufs(bufs), numPartitions(numParts), flusherStop(false), prefetchActive(NULL), prefetchStop(false) {
+	if (numPartitions == 0 || numPartitions > bufs)
+		throw BufferExceededException();
+
 	bufDescTable = new BufDesc[bufs];
 
-  for (FrameId i = 0; i < bufs; i++) 
+  for (FrameId i = 0; i < bufs; i++)
   {
   	bufDescTable[i].frameNo = i;
   	bufDescTable[i].valid = false;
@@ -32,16 +39,36 @@ BufMgr::BufMgr(std::uint32_t bufs)
 
   bufPool = new Page[bufs];
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
-
-  clockHand = bufs - 1;
+	// split the frames as evenly as possible over the partitions
+	partitions = new BufPartition[numPartitions];
+	FrameId firstFrame = 0;
+	for (std::uint32_t i = 0; i < numPartitions; i++)
+	{
+		BufPartition &partition = partitions[i];
+		partition.firstFrame = firstFrame;
+		partition.numFrames = bufs / numPartitions + (i < bufs % numPartitions ? 1 : 0);
+		partition.hashTable = new BufHashTbl(2 * partition.numFrames);  // allocate the buffer hash table, two entries per frame: its page and the page being written back
+		partition.policy = ReplacementPolicy::create(policy, bufDescTable, firstFrame, partition.numFrames);
+		partition.flushCursor = firstFrame;
+		firstFrame += partition.numFrames;
+	}
 }
 
 
 BufMgr::~BufMgr() {
+  if (prefetcher.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> guard(prefetchLock);
+      prefetchStop = true;
+    }
+    prefetchWake.notify_one();
+    prefetcher.join();
+  }
+  stopFlusher();
+
   //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+  for (std::uint32_t i = 0; i < numBufs; i++)
   {
   	BufDesc* tmpbuf = &bufDescTable[i];
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
@@ -50,113 +77,184 @@ BufMgr::~BufMgr() {
   	}
   }
 
+	for (std::uint32_t i = 0; i < numPartitions; i++)
+	{
+		delete partitions[i].hashTable;
+		delete partitions[i].policy;
+	}
+	delete [] partitions;
   delete [] bufDescTable;
   delete [] bufPool;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+BufPartition &BufMgr::partitionOf(const File* file, const PageId pageNo)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+	if (numPartitions == 1)
+		return partitions[0];
+
+	// mix the file pointer and the page number so consecutive pages of a file
+	// land in different partitions
+	std::uint64_t value = (std::uint64_t)(std::uintptr_t)file ^ ((std::uint64_t)pageNo * 0x9e3779b97f4a7c15ULL);
+	value ^= value >> 29;
+	value *= 0xbf58476d1ce4e5b9ULL;
+	value ^= value >> 32;
+	return partitions[value % numPartitions];
+}
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+void BufMgr::reserveFrame(BufPartition &partition, File* file, const PageId pageNo, FrameId &frame)
+{
+  // ask the replacement policy of the partition for a frame
+  if (!partition.policy->chooseVictim(frame))
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    // check for full buffer pool
+    throw BufferExceededException();
+  }
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+  BufDesc &desc = bufDescTable[frame];
+  File* evictFile = NULL;
+  PageId evictPageNo = Page::INVALID_NUMBER;
+  if (desc.valid)
+  {
+    if (desc.dirty)
     {
-      break;
+      // written back by fillFrame(); the hash table entry stays until then
+      flusherWake.notify_one();
+      partition.bufStats.diskwrites++;
+      evictFile = desc.file;
+      evictPageNo = desc.pageNo;
     }
+    else
+      partition.hashTable->remove(desc.file, desc.pageNo);
+  }
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+  desc.Clear();
+  desc.Set(file, pageNo);
+  desc.evictFile = evictFile;
+  desc.evictPageNo = evictPageNo;
+  desc.latch.lockExclusive();
+  desc.loading = true;
+  partition.policy->pageLoaded(frame, file, pageNo);
+  partition.hashTable->insert(file, pageNo, frame);
+}
+
+void BufMgr::fillFrame(BufPartition &partition, const FrameId frame, const Page* page)
+{
+  // the frame is pinned and loading, so nobody else changes its page or evicted page
+  BufDesc &desc = bufDescTable[frame];
+  try
+  {
+    if (desc.evictFile != NULL)
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
+      desc.evictFile->writePage(desc.evictPageNo, bufPool[frame]);
+
+      std::lock_guard<std::mutex> guard(partition.lock);
+      partition.hashTable->remove(desc.evictFile, desc.evictPageNo);
+      desc.evictFile = NULL;
+      desc.evictPageNo = Page::INVALID_NUMBER;
     }
+
+    if (page != NULL)
+      bufPool[frame] = *page;
     else
-    {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
-    }
+      bufPool[frame] = desc.file->readPage(desc.pageNo);
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  catch (...)
   {
-    throw BufferExceededException();
+    // take the page out of the pool; threads waiting for it retry
+    std::lock_guard<std::mutex> guard(partition.lock);
+    if (desc.evictFile != NULL)
+      partition.hashTable->remove(desc.evictFile, desc.evictPageNo);
+    partition.hashTable->remove(desc.file, desc.pageNo);
+    desc.file = NULL;
+    desc.pageNo = Page::INVALID_NUMBER;
+    desc.evictFile = NULL;
+    desc.evictPageNo = Page::INVALID_NUMBER;
+    desc.valid = false;
+    desc.loadFailed = true;
+    desc.loading.store(false, std::memory_order_release);
+    desc.latch.unlockExclusive();
+    if (--desc.pinCnt == 0)
+    {
+      desc.Clear();
+      partition.policy->frameFreed(frame);
+    }
+    throw;
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  desc.loading.store(false, std::memory_order_release);
+  desc.latch.unlockExclusive();
+}
+
+bool BufMgr::waitForFrame(BufPartition &partition, const FrameId frame, const File* file, const PageId pageNo)
+{
+  BufDesc &desc = bufDescTable[frame];
+  if (desc.loading.load(std::memory_order_acquire))
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    desc.latch.lockShared();
+    desc.latch.unlockShared();
   }
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  // the pin keeps the frame from being reassigned, so its page can be read without the lock
+  if (desc.file == file && desc.pageNo == pageNo)
+    return true;
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+  std::lock_guard<std::mutex> guard(partition.lock);
+  if (--desc.pinCnt == 0 && desc.loadFailed)
+  {
+    desc.Clear();
+    partition.policy->frameFreed(frame);
+  }
+  return false;
+}
 
-	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
-
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
-  }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+  BufPartition &partition = partitionOf(file, pageNo);
+  while (1)
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    std::unique_lock<std::mutex> guard(partition.lock);
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    // check to see if it is already in the buffer pool
+    FrameId frameNo = 0;
+    partition.bufStats.accesses++;
+    if (partition.hashTable->find(file, pageNo, frameNo))
+    {
+      // set the referenced bit
+      partition.bufStats.hits++;
+      bufDescTable[frameNo].refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+      partition.policy->pageAccessed(frameNo);
+      guard.unlock();
+
+      // another thread may still be reading the page in or writing it out of the frame
+      if (!waitForFrame(partition, frameNo, file, pageNo))
+        continue;
+      page = &bufPool[frameNo];
+      return;
+    }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+    //not in the buffer pool, reserve a frame and read the page into it without the lock
+    partition.bufStats.misses++;
+    partition.bufStats.diskreads++;
+    reserveFrame(partition, file, pageNo, frameNo);
+    guard.unlock();
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+    fillFrame(partition, frameNo, NULL);
+    page = &bufPool[frameNo];
+    return;
   }
 }
 
 
-void BufMgr::unPinPage(File* file, const PageId pageNo, 
-			     const bool dirty) 
+void BufMgr::unPinPage(File* file, const PageId pageNo,
+			     const bool dirty)
 {
-  // lookup in hashtable
+  BufPartition &partition = partitionOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(partition.lock);
+
+  // lookup in hashtable; unpinning a page that is not in the pool is a caller error
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  partition.hashTable->lookup(file, pageNo, frameNo);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
 
@@ -168,72 +266,446 @@ void BufMgr::unPinPage(File* file, const PageId pageNo,
   else bufDescTable[frameNo].pinCnt--;
 }
 
-void BufMgr::flushFile(const File* file) 
+void BufMgr::flushFile(const File* file)
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
-
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+  cancelPrefetch(file);
+
+  // find the dirty pages of the file and pin them, so that their frames are neither reused nor
+  // written by the flusher while they are written below; no page of the file may be pinned already
+  std::vector<std::pair<PageId, FrameId> > dirtyPages;
+  try
+  {
+    for (std::uint32_t p = 0; p < numPartitions; p++)
+    {
+      BufPartition &partition = partitions[p];
+      std::unique_lock<std::mutex> guard(partition.lock);
+      const std::size_t partitionStart = dirtyPages.size();
+      FrameId i = partition.firstFrame;
+      while (i < partition.firstFrame + partition.numFrames)
+      {
+        BufDesc* tmpbuf = &(bufDescTable[i]);
+        if (tmpbuf->flushing && tmpbuf->file == file)
+        {
+          // the flusher is writing a page of the file; wait for it and look at the partition again
+          for (std::size_t k = partitionStart; k < dirtyPages.size(); k++)
+            bufDescTable[dirtyPages[k].second].pinCnt--;
+          dirtyPages.resize(partitionStart);
+          partition.flushDone.wait(guard);
+          i = partition.firstFrame;
+          continue;
+        }
+
+        if (tmpbuf->evictFile == file)
+        {
+          // a page of the file is being written back to make room for another page; wait for it
+          // and look at the partition again
+          for (std::size_t k = partitionStart; k < dirtyPages.size(); k++)
+            bufDescTable[dirtyPages[k].second].pinCnt--;
+          dirtyPages.resize(partitionStart);
+          guard.unlock();
+          tmpbuf->latch.lockShared();
+          tmpbuf->latch.unlockShared();
+          guard.lock();
+          i = partition.firstFrame;
+          continue;
+        }
+
+        if(tmpbuf->valid == true && tmpbuf->file == file)
+        {
+          if (tmpbuf->pinCnt > 0)
+            throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+
+          if (tmpbuf->dirty == true)
+          {
+            tmpbuf->pinCnt++;
+            dirtyPages.push_back(std::make_pair(tmpbuf->pageNo, i));
+          }
+        }
+        else if (tmpbuf->valid == false && tmpbuf->file == file)
+          throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+        i++;
+      }
+    }
+
+    // write runs of consecutive pages with one vectored write each, without holding any lock
+    std::sort(dirtyPages.begin(), dirtyPages.end());
+    File *writeFile = const_cast<File*>(file);
+    for (std::size_t first = 0; first < dirtyPages.size(); )
+    {
+      std::vector<const Page*> run(1, &bufPool[dirtyPages[first].second]);
+      std::size_t last = first;
+      while (last + 1 < dirtyPages.size() && dirtyPages[last + 1].first == dirtyPages[last].first + 1)
+      {
+        last++;
+        run.push_back(&bufPool[dirtyPages[last].second]);
+      }
+      writeFile->writePages(dirtyPages[first].first, run);
+      first = last + 1;
+    }
+  }
+  catch (...)
+  {
+    // the pages stay dirty
+    for (std::size_t k = 0; k < dirtyPages.size(); k++)
+    {
+      std::lock_guard<std::mutex> guard(partitionOf(file, dirtyPages[k].first).lock);
+      bufDescTable[dirtyPages[k].second].pinCnt--;
+    }
+    throw;
+  }
+
+  // the pages are on disk now
+  for (std::size_t k = 0; k < dirtyPages.size(); k++)
+  {
+    BufPartition &partition = partitionOf(file, dirtyPages[k].first);
+    std::lock_guard<std::mutex> guard(partition.lock);
+    BufDesc &desc = bufDescTable[dirtyPages[k].second];
+    partition.bufStats.diskwrites++;
+    desc.dirty = false;
+    desc.pinCnt--;
+  }
+
+  // drop the pages of the file from the pool
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition &partition = partitions[p];
+    std::lock_guard<std::mutex> guard(partition.lock);
+    for (FrameId i = partition.firstFrame; i < partition.firstFrame + partition.numFrames; i++)
+    {
+      BufDesc* tmpbuf = &(bufDescTable[i]);
+      if(tmpbuf->valid == true && tmpbuf->file == file)
+      {
+        if (tmpbuf->pinCnt > 0)
+          throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+
+        if (tmpbuf->dirty == true)
+        {
+          partition.bufStats.diskwrites++;
+          tmpbuf->dirty = false;
+        }
+
+        partition.hashTable->remove(file,tmpbuf->pageNo);
+        tmpbuf->Clear();
+        partition.policy->frameFreed(i);
+      }
+    }
   }
 }
 
-void BufMgr::disposePage(File* file, const PageId pageNo) 
+void BufMgr::disposePage(File* file, const PageId pageNo)
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  cancelPrefetch(file);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+  BufPartition &partition = partitionOf(file, pageNo);
+  while (1)
+  {
+    std::unique_lock<std::mutex> guard(partition.lock);
 
-	hashTable->remove(file, pageNo);
+    //Deallocate from file altogether
+    //See if it is in the buffer pool
+    FrameId frameNo = 0;
+    if (partition.hashTable->find(file, pageNo, frameNo))
+    {
+      // let a write-back of the page finish before its frame is given up
+      BufDesc &desc = bufDescTable[frameNo];
+      if (desc.loading)
+      {
+        guard.unlock();
+        desc.latch.lockShared();
+        desc.latch.unlockShared();
+        continue;
+      }
 
-  // deallocate it in the file	
+      // and a write by the flusher
+      if (desc.flushing)
+      {
+        partition.flushDone.wait(guard);
+        continue;
+      }
+
+      // clear the page
+      desc.Clear();
+
+      partition.hashTable->remove(file, pageNo);
+      partition.policy->frameFreed(frameNo);
+    }
+    break;
+  }
+
+  // deallocate it in the file
   file->deletePage(pageNo);
 }
 
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 {
-  FrameId frameNo;
+  // allocate a new page in the file first, its number decides the partition
+  Page newPage = file->allocatePage(pageNo);
 
-  // alloc a new frame
-  allocBuf(frameNo);
+  BufPartition &partition = partitionOf(file, pageNo);
+  FrameId frameNo;
+  {
+    std::lock_guard<std::mutex> guard(partition.lock);
+    partition.bufStats.accesses++;
+    reserveFrame(partition, file, pageNo, frameNo);
+  }
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  fillFrame(partition, frameNo, &newPage);
   page = &bufPool[frameNo];
+}
+
+void BufMgr::prefetchPages(File* file, const std::vector<PageId> &pageNos)
+{
+  if (pageNos.empty())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(prefetchLock);
+    if (!prefetcher.joinable())
+      prefetcher = std::thread(&BufMgr::runPrefetcher, this);
+
+    // a queue longer than the pool would only evict pages prefetched earlier
+    for (std::size_t i = 0; i < pageNos.size() && prefetchQueue.size() < numBufs; i++)
+    {
+      prefetchQueue.push_back(std::make_pair(file, pageNos[i]));
+    }
+  }
+  prefetchWake.notify_one();
+}
+
+void BufMgr::runPrefetcher()
+{
+  std::unique_lock<std::mutex> guard(prefetchLock);
+  while (1)
+  {
+    while (prefetchQueue.empty() && !prefetchStop)
+      prefetchWake.wait(guard);
+    if (prefetchStop)
+      break;
+
+    std::pair<File*, PageId> request = prefetchQueue.front();
+    prefetchQueue.pop_front();
+    prefetchActive = request.first;
+    guard.unlock();
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+    prefetchPage(request.first, request.second);
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+    guard.lock();
+    prefetchActive = NULL;
+    prefetchDone.notify_all();
+  }
 }
 
-void BufMgr::printSelf(void) 
+void BufMgr::prefetchPage(File* file, const PageId pageNo)
+{
+  BufPartition &partition = partitionOf(file, pageNo);
+  FrameId frameNo = 0;
+  {
+    std::lock_guard<std::mutex> guard(partition.lock);
+    if (partition.hashTable->find(file, pageNo, frameNo))
+      return;
+
+    try
+    {
+      reserveFrame(partition, file, pageNo, frameNo);
+    }
+    catch (BufferExceededException &e)
+    {
+      return;
+    }
+    partition.bufStats.diskreads++;
+    partition.bufStats.prefetchreads++;
+  }
+
+  // the prefetcher holds the pin while the page is read; readers asking for it meanwhile wait
+  try
+  {
+    fillFrame(partition, frameNo, NULL);
+  }
+  catch (BadgerDbException &e)
+  {
+    // the page does not exist (any more); fillFrame() gave the frame back
+    return;
+  }
+
+  // the page stays unpinned until readPage() asks for it
+  std::lock_guard<std::mutex> guard(partition.lock);
+  bufDescTable[frameNo].pinCnt--;
+}
+
+void BufMgr::cancelPrefetch(const File* file)
+{
+  std::unique_lock<std::mutex> guard(prefetchLock);
+  for (std::deque<std::pair<File*, PageId> >::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); )
+  {
+    if (it->first == file)
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
+  }
+  while (prefetchActive == file)
+    prefetchDone.wait(guard);
+}
+
+void BufMgr::startFlusher(const BufFlusherOptions &options)
+{
+  stopFlusher();
+  flusherOptions = options;
+  flusherStop = false;
+  flusher = std::thread(&BufMgr::runFlusher, this);
+}
+
+void BufMgr::stopFlusher()
+{
+  if (!flusher.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(flusherLock);
+    flusherStop = true;
+  }
+  flusherWake.notify_one();
+  flusher.join();
+}
+
+void BufMgr::runFlusher()
+{
+  const std::chrono::milliseconds interval(flusherOptions.intervalMs);
+  const double maxCredit = std::max(1.0, flusherOptions.pagesPerSecond);
+  double credit = 0;
+  std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> guard(flusherLock);
+  while (!flusherStop)
+  {
+    guard.unlock();
+
+    // refill the write allowance for the time since the previous pass
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - last;
+    last = now;
+    credit = std::min(maxCredit, credit + flusherOptions.pagesPerSecond * elapsed.count());
+
+    for (std::uint32_t p = 0; p < numPartitions; p++)
+    {
+      try
+      {
+        flushPartition(partitions[p], credit);
+      }
+      catch (const BadgerDbException &)
+      {
+        // the pages that could not be written stay dirty and are tried again on a later pass
+      }
+    }
+
+    guard.lock();
+    if (!flusherStop)
+      flusherWake.wait_for(guard, interval);
+  }
+}
+
+void BufMgr::flushPartition(BufPartition &partition, double &credit)
+{
+  std::unique_lock<std::mutex> guard(partition.lock);
+
+  std::uint32_t dirty = 0, clean = 0;
+  for (FrameId i = partition.firstFrame; i < partition.firstFrame + partition.numFrames; i++)
+  {
+    BufDesc &desc = bufDescTable[i];
+    if (!desc.valid)
+      clean++;
+    else if (desc.dirty)
+      dirty++;
+    else if (desc.pinCnt == 0)
+      clean++;
+  }
+
+  const double highWater = flusherOptions.dirtyHighWater * partition.numFrames;
+  const double cleanTarget = flusherOptions.cleanTarget * partition.numFrames;
+  const bool unlimited = flusherOptions.pagesPerSecond <= 0;
+
+  // sweep at most once around the partition, picking up where the previous pass stopped
+  for (std::uint32_t scanned = 0; scanned < partition.numFrames; scanned++)
+  {
+    const bool urgent = dirty > highWater;
+    if (!urgent && clean >= cleanTarget)
+      break;
+    if (!urgent && !unlimited && credit < 1)
+      break;
+
+    FrameId frame = partition.flushCursor;
+    partition.flushCursor = partition.firstFrame + (frame - partition.firstFrame + 1) % partition.numFrames;
+
+    BufDesc &desc = bufDescTable[frame];
+    if (!desc.valid || !desc.dirty || desc.pinCnt > 0)
+      continue;
+
+    // the file must not be closed while the flusher may write its pages (see startFlusher())
+    assert(File::isLive(desc.file));
+    if (!File::isLive(desc.file))
+      continue;
+
+    // pin the frame so that it is not reused, and write the page without holding the partition lock;
+    // a page modified meanwhile is marked dirty again when it is unpinned
+    desc.pinCnt++;
+    desc.flushing = true;
+    desc.dirty = false;
+    guard.unlock();
+
+    desc.latch.lockShared();
+    try
+    {
+      desc.file->writePage(desc.pageNo, bufPool[frame]);
+    }
+    catch (...)
+    {
+      desc.latch.unlockShared();
+      guard.lock();
+      desc.dirty = true;
+      desc.flushing = false;
+      desc.pinCnt--;
+      partition.flushDone.notify_all();
+      throw;
+    }
+    desc.latch.unlockShared();
+
+    guard.lock();
+    desc.flushing = false;
+    desc.pinCnt--;
+    partition.flushDone.notify_all();
+    partition.bufStats.diskwrites++;
+    partition.bufStats.flusherwrites++;
+    dirty--;
+    clean++;
+    if (!urgent && !unlimited)
+      credit -= 1;
+  }
+}
+
+BufStats & BufMgr::getBufStats()
+{
+  bufStats.clear();
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].lock);
+    bufStats.add(partitions[p].bufStats);
+  }
+  return bufStats;
+}
+
+void BufMgr::clearBufStats()
+{
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].lock);
+    partitions[p].bufStats.clear();
+  }
+  bufStats.clear();
+}
+
+void BufMgr::printSelf(void)
 {
   BufDesc* tmpbuf;
 	int validFrames = 0;
-  
+
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	tmpbuf = &(bufDescTable[i]);
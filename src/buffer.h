@@ -10,6 +10,12 @@
 #include "file.h"
 #include "bufHashTbl.h"
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <vector>
 
 namespace badgerdb {
 
@@ -17,13 +23,92 @@ namespace badgerdb {
 * forward declaration of BufMgr class 
 */
 class BufMgr;
+class ReplacementPolicy;
+
+/**
+* @brief Default number of pages scans ask the buffer manager to read ahead.
+*/
+const std::uint32_t DEFAULT_PREFETCH_WINDOW = 8;
+
+/**
+* @brief Replacement policies the buffer manager can use to choose the frame to evict.
+*/
+enum ReplacementPolicyType
+{
+	CLOCK_POLICY,
+	LRU_K_POLICY,
+	TWO_Q_POLICY
+};
+
+/**
+* @brief Shared/exclusive latch protecting the contents of one buffer pool frame.
+*
+* Pinning a page only keeps it from being evicted; threads that read a page other threads may
+* modify take the latch in shared mode, and threads that modify the page take it in exclusive mode.
+* The latch spins (yielding the processor) since it is only held while a page is being accessed.
+*/
+class FrameLatch {
+ public:
+	FrameLatch()
+		: state(0)
+	{
+	}
+
+	/**
+	 * Acquire the latch in shared mode, waiting while it is held exclusively
+	 */
+	void lockShared()
+	{
+		while (1)
+		{
+			int current = state.load(std::memory_order_relaxed);
+			if (current >= 0 && state.compare_exchange_weak(current, current + 1, std::memory_order_acquire))
+				return;
+			std::this_thread::yield();
+		}
+	}
+
+	void unlockShared()
+	{
+		state.fetch_sub(1, std::memory_order_release);
+	}
+
+	/**
+	 * Acquire the latch in exclusive mode, waiting until no one else holds it
+	 */
+	void lockExclusive()
+	{
+		while (1)
+		{
+			int current = 0;
+			if (state.compare_exchange_weak(current, -1, std::memory_order_acquire))
+				return;
+			std::this_thread::yield();
+		}
+	}
+
+	void unlockExclusive()
+	{
+		state.store(0, std::memory_order_release);
+	}
+
+ private:
+	/**
+	 * Number of shared holders, or -1 while held exclusively
+	 */
+	std::atomic<int> state;
+};
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* file, pageNo, dirty, valid, loadFailed, flushing and the evicted page only change while the partition owning
+* the frame is locked. pinCnt, refbit and loading are atomic so that they can be read without taking that lock.
 */
 class BufDesc {
 
 	friend class BufMgr;
+	friend class ReplacementPolicy;
 
  private:
 	/**
@@ -44,7 +129,7 @@ class BufDesc {
 	/**
    * Number of times this page has been pinned
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
@@ -59,7 +144,37 @@ class BufDesc {
 	/**
    * Has this buffer frame been reference recently
 	 */
-  bool refbit;
+  std::atomic<bool> refbit;
+
+	/**
+   * Latch protecting the page held in the frame
+	 */
+  FrameLatch latch;
+
+	/**
+   * True while the page is being brought into the frame without the partition lock held. The thread
+   * doing the I/O holds the latch exclusively until the page is in place.
+	 */
+  std::atomic<bool> loading;
+
+	/**
+   * True once a load failed; the frame holds no page and is freed by its last user
+	 */
+  bool loadFailed;
+
+	/**
+   * True while the background flusher writes the page without the partition lock held. The flusher
+   * keeps the frame pinned until the write is done.
+	 */
+  bool flushing;
+
+	/**
+   * Dirty page the frame held before it was reserved, written back before the new page is read.
+   * Its hash table entry stays until the write is done so that nobody reads a stale copy from disk.
+   * evictFile is NULL when there is no such page.
+	 */
+  File* evictFile;
+  PageId evictPageNo;
 
 	/**
    * Initialize buffer frame for a new user
@@ -72,6 +187,11 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+    loading = false;
+    loadFailed = false;
+    flushing = false;
+    evictFile = NULL;
+    evictPageNo = Page::INVALID_NUMBER;
   };
 
 	/**
@@ -102,9 +222,9 @@ class BufDesc {
 			std::cout << "file:NULL ";
 
 		std::cout << "valid:" << valid << " ";
-		std::cout << "pinCnt:" << pinCnt << " ";
+		std::cout << "pinCnt:" << pinCnt.load() << " ";
 		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "refbit:" << refbit.load() << "\n";
   }
 
 	/**
@@ -127,6 +247,16 @@ struct BufStats
 	 */
   int accesses;
 
+	/**
+   * Number of pages requested with readPage() that were found in the buffer pool
+	 */
+  int hits;
+
+	/**
+   * Number of pages requested with readPage() that had to be read from disk
+	 */
+  int misses;
+
 	/**
    * Number of pages read from disk (including allocs)
 	 */
@@ -137,12 +267,44 @@ struct BufStats
 	 */
   int diskwrites;
 
+	/**
+   * Number of the diskwrites done by the background flusher
+	 */
+  int flusherwrites;
+
+	/**
+   * Number of the diskreads done to service prefetchPages()
+	 */
+  int prefetchreads;
+
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = hits = misses = diskreads = diskwrites = flusherwrites = prefetchreads = 0;
+  }
+
+	/**
+   * Fraction of readPage() requests served from the buffer pool
+	 */
+  double hitRatio() const
+  {
+		return hits + misses == 0 ? 0.0 : (double)hits / (hits + misses);
+  }
+
+	/**
+   * Add the values of another set of statistics to these
+	 */
+  void add(const BufStats &other)
+  {
+		accesses += other.accesses;
+		hits += other.hits;
+		misses += other.misses;
+		diskreads += other.diskreads;
+		diskwrites += other.diskwrites;
+		flusherwrites += other.flusherwrites;
+		prefetchreads += other.prefetchreads;
   }
       
 	/**
@@ -155,26 +317,117 @@ struct BufStats
 };
 
 
+/**
+* @brief One partition of the buffer pool.
+*
+* A partition owns a contiguous range of frames, the hash table mapping the pages it holds to those
+* frames and the replacement policy choosing which of them to reuse. Every page is assigned to a partition by hashing
+* (file, pageNo), so threads working on different pages rarely contend for the same partition lock.
+*/
+struct BufPartition
+{
+	/**
+   * Protects the hash table, the policy, the statistics and the descriptors of the frames of the partition
+	 */
+  std::mutex lock;
+
+	/**
+   * First frame of the partition
+	 */
+  FrameId firstFrame;
+
+	/**
+   * Number of frames in the partition
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Hash table mapping (File, page) to frame for pages of this partition
+	 */
+  BufHashTbl *hashTable;
+
+	/**
+   * Replacement policy over the frames of the partition
+	 */
+  ReplacementPolicy *policy;
+
+	/**
+   * Buffer pool usage statistics of this partition
+	 */
+  BufStats bufStats;
+
+	/**
+   * Next frame the background flusher looks at
+	 */
+  FrameId flushCursor;
+
+	/**
+   * Signalled, with the lock held, when the flusher is done writing a page of the partition
+	 */
+  std::condition_variable flushDone;
+};
+
+
+/**
+* @brief Tunables of the background flusher started with BufMgr::startFlusher().
+*
+* The flusher writes dirty, unpinned pages back so that readPage() and allocPage() find clean frames
+* to reuse instead of writing a victim out themselves.
+*/
+struct BufFlusherOptions
+{
+	/**
+   * Maximum number of pages written per second, 0 for no limit. The limit does not apply while the
+   * pool is above the dirty high-water mark.
+	 */
+  double pagesPerSecond;
+
+	/**
+   * Fraction of the frames of a partition that may be dirty before the flusher writes at full speed
+	 */
+  double dirtyHighWater;
+
+	/**
+   * Fraction of the frames of a partition the flusher tries to keep clean and unpinned (or empty)
+	 */
+  double cleanTarget;
+
+	/**
+   * Milliseconds the flusher sleeps between two passes over the buffer pool
+	 */
+  unsigned int intervalMs;
+
+  BufFlusherOptions()
+		: pagesPerSecond(1000), dirtyHighWater(0.5), cleanTarget(0.25), intervalMs(10)
+  {
+  }
+};
+
+
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* BufMgr can be shared by several threads. The pool is split into partitions (see BufPartition), each
+* with its own lock, page table and replacement policy. Pages are read from and written back to disk
+* without that lock; the frame is reserved for the page meanwhile (see BufDesc::loading).
 */
 class BufMgr 
 {
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Number of frames in the buffer pool
 	 */
-  FrameId clockHand;
+  std::uint32_t numBufs;
 
 	/**
-   * Number of frames in the buffer pool
+   * Number of partitions the buffer pool is split into
 	 */
-  std::uint32_t numBufs;
-	
+  std::uint32_t numPartitions;
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Partitions of the buffer pool
 	 */
-  BufHashTbl *hashTable;
+  BufPartition *partitions;
 
 	/**
    * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
@@ -182,26 +435,137 @@ class BufMgr
   BufDesc *bufDescTable;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Sum of the statistics of all partitions, filled in by getBufStats()
 	 */
   BufStats bufStats;
 
 	/**
-	 * Allocate a free frame.  
+   * Background flusher thread, if started
+	 */
+  std::thread flusher;
+
+	/**
+   * Protects flusherStop and wakes the flusher up early
+	 */
+  std::mutex flusherLock;
+  std::condition_variable flusherWake;
+  bool flusherStop;
+
+	/**
+   * Tunables of the running flusher
+	 */
+  BufFlusherOptions flusherOptions;
+
+	/**
+   * Body of the background flusher thread
+	 */
+  void runFlusher();
+
+	/**
+   * Thread servicing prefetchPages(), started by the first request
+	 */
+  std::thread prefetcher;
+
+	/**
+   * Protects the prefetch queue, prefetchActive and prefetchStop
+	 */
+  std::mutex prefetchLock;
+
+	/**
+   * Signalled when requests are queued or the prefetcher must stop
+	 */
+  std::condition_variable prefetchWake;
+
+	/**
+   * Signalled when the prefetcher finishes a page
+	 */
+  std::condition_variable prefetchDone;
+
+	/**
+   * Pages waiting to be prefetched
+	 */
+  std::deque<std::pair<File*, PageId> > prefetchQueue;
+
+	/**
+   * File of the page being prefetched, NULL when the prefetcher is idle
+	 */
+  const File *prefetchActive;
+  bool prefetchStop;
+
+	/**
+   * Body of the prefetcher thread
+	 */
+  void runPrefetcher();
+
+	/**
+	 * Read a page into an unpinned frame unless it is already buffered or no frame can be freed.
+	 * The page is read without the partition lock, like readPage() does.
 	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
 	 */
-  void allocBuf(FrameId & frame);
+  void prefetchPage(File* file, const PageId pageNo);
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Drop the queued prefetches of the file and wait for the one being serviced, so that the file
+	 * can be flushed and closed.
+	 *
+	 * @param file   	File object
 	 */
-  void advanceClock()
-  {
-		clockHand = (clockHand + 1) % numBufs;
-  }
+  void cancelPrefetch(const File* file);
+
+	/**
+	 * One flusher pass over a partition: writes dirty, unpinned pages starting at the partition's flush
+	 * cursor until the partition has enough clean frames and is below the dirty high-water mark.
+	 *
+	 * @param partition	Partition to clean
+	 * @param credit		Number of pages the write rate still allows, decreased by the pages written
+	 */
+  void flushPartition(BufPartition &partition, double &credit);
 
+	/**
+   * Returns the partition that holds (file, pageNo) when it is buffered
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  BufPartition &partitionOf(const File* file, const PageId pageNo);
+
+	/**
+	 * Take a frame of the partition for a page that is not buffered and enter the page in the hash table.
+	 * The frame is returned pinned, with loading set and its latch held exclusively, and must be passed
+	 * to fillFrame() once the partition lock is released. The partition must be locked by the caller.
+	 *
+	 * @param partition	Partition of the page
+	 * @param file   		File object
+	 * @param pageNo  	Page number in the file
+	 * @param frame   	Frame ID of the reserved frame returned via this variable
+	 * @throws BufferExceededException If every frame of the partition is pinned
+	 */
+  void reserveFrame(BufPartition &partition, File* file, const PageId pageNo, FrameId &frame);
+
+	/**
+	 * Write back the page the reserved frame held if it was dirty, then read the page the frame is
+	 * reserved for, or copy it from page, and release the frame to waiting readers. Called without the
+	 * partition lock. If the I/O fails the page leaves the pool and the frame is unpinned.
+	 *
+	 * @param partition	Partition of the frame
+	 * @param frame   	Frame returned by reserveFrame()
+	 * @param page  		Contents of the page, NULL to read it from its file
+	 */
+  void fillFrame(BufPartition &partition, const FrameId frame, const Page* page);
+
+	/**
+	 * Wait until a frame pinned by the caller is no longer loading. Called without the partition lock.
+	 *
+	 * @param partition	Partition of the frame
+	 * @param frame   	Frame found in the hash table for (file, pageNo)
+	 * @param file   		File object
+	 * @param pageNo  	Page number in the file
+	 * @return True if the frame holds the page; otherwise the frame was being evicted or its load failed,
+	 *				it has been unpinned again and the lookup must be retried
+	 */
+  bool waitForFrame(BufPartition &partition, const FrameId frame, const File* file, const PageId pageNo);
 
  public:
 	/**
@@ -211,8 +575,13 @@ class BufMgr
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs					Number of frames in the buffer pool
+	 * @param partitions		Number of partitions the pool is split into. Use more than one when several
+	 *										threads share the buffer manager; each partition must have at least one frame.
+	 * @param policy				Replacement policy used to choose the frames to evict
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, std::uint32_t partitions = 1, ReplacementPolicyType policy = CLOCK_POLICY);
 	
 	/**
    * Destructor of BufMgr class
@@ -271,25 +640,74 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
-   * Print member variable values. 
+	 * Ask for pages to be read into the buffer pool ahead of use. The pages are read by a background
+	 * thread and left unpinned; requests for pages already buffered, or that cannot get a frame
+	 * because every frame is pinned, are dropped. readPage() still has to be called to use a page.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Numbers of the pages in the file, in the order they will be used
 	 */
-  void  printSelf();
+  void prefetchPages(File* file, const std::vector<PageId> &pageNos);
+
+	/**
+	 * Start the background flusher. It runs until stopFlusher() is called or the buffer manager is destroyed.
+	 * The flusher writes through the File objects the pages were read with, so while it runs flushFile()
+	 * must be called for a file before its File object is closed or destroyed.
+	 *
+	 * @param options		Write rate, dirty high-water mark and clean frame target of the flusher
+	 */
+  void startFlusher(const BufFlusherOptions &options = BufFlusherOptions());
 
 	/**
-   * Get buffer pool usage statistics
+	 * Stop the background flusher, waiting for the page it is writing. Does nothing if it is not running.
 	 */
-  BufStats & getBufStats()
+  void stopFlusher();
+
+	/**
+	 * Acquire the latch of the frame holding a pinned page.
+	 * Threads sharing a page latch it in shared mode to read it and in exclusive mode to modify it.
+	 *
+	 * @param page  			Page returned by readPage() or allocPage() and still pinned
+	 * @param exclusive		True to acquire the latch in exclusive mode
+	 */
+  void latchPage(const Page* page, const bool exclusive)
   {
-		return bufStats;
+		BufDesc &desc = bufDescTable[page - bufPool];
+		if (exclusive)
+			desc.latch.lockExclusive();
+		else
+			desc.latch.lockShared();
   }
 
 	/**
-   * Clear buffer pool usage statistics
+	 * Release the latch acquired with latchPage().
+	 *
+	 * @param page  			Page whose latch is released
+	 * @param exclusive		True if the latch was acquired in exclusive mode
 	 */
-  void clearBufStats() 
+  void unlatchPage(const Page* page, const bool exclusive)
   {
-		bufStats.clear();
+		BufDesc &desc = bufDescTable[page - bufPool];
+		if (exclusive)
+			desc.latch.unlockExclusive();
+		else
+			desc.latch.unlockShared();
   }
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+   * Get buffer pool usage statistics, summed over all partitions
+	 */
+  BufStats & getBufStats();
+
+	/**
+   * Clear buffer pool usage statistics
+	 */
+  void clearBufStats();
 };
 
 }
@@ -0,0 +1,28 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_io_exception.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+FileIOException::FileIOException(const std::string& name,
+                                 const std::string& operation,
+                                 const int error)
+    : BadgerDbException(""),
+      filename_(name),
+      error_(error) {
+  std::stringstream ss;
+  ss << "I/O error in " << operation << " on file '" << filename_ << "': "
+     << std::strerror(error_);
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,435 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <queue>
+#include <algorithm>
+#include "string.h"
+
+#include "btree.h"
+#include "file.h"
+#include "buffer.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Maximum number of runs merged at once. Each run being merged keeps one page pinned.
+ */
+const int EXTERNAL_SORT_MAX_FANIN = 16;
+
+/**
+ * @brief Number of bytes a key takes inside a run page. STRING keys are stored like in the index, as STRINGSIZE chars.
+ */
+template <class T>
+struct SortKeySize {
+	static const int value = sizeof(T);
+};
+
+template <>
+struct SortKeySize<std::string> {
+	static const int value = STRINGSIZE;
+};
+
+/**
+ * @brief Sorts a stream of RIDKeyPair<T> that may not fit in memory.
+ *
+ * Each pair may carry a payload of a fixed number of bytes, which travels with it through the
+ * sort and is returned by next() next to the pair. Pairs are collected with add() until the memory budget is reached; the collected pairs are then
+ * sorted and written as a run into a temporary BlobFile through the buffer manager. After finish(),
+ * next() returns all pairs in ascending order, k-way merging the runs (in several passes if there
+ * are more than EXTERNAL_SORT_MAX_FANIN of them). When everything fits in the budget no run is
+ * written at all. Temporary files are removed when the sorter is destroyed.
+ */
+template <class T>
+class ExternalSorter {
+ public:
+
+  /**
+   * @param bufMgrIn      Buffer Manager Instance used to read and write the runs
+   * @param filePrefix    Prefix of the temporary run file names
+   * @param memoryBudget  Number of bytes of pairs kept in memory before a run is spilled
+   * @param payloadWidthIn  Number of payload bytes carried by every pair, 0 for none
+   */
+	ExternalSorter(BufMgr *bufMgrIn, const std::string &filePrefix, std::size_t memoryBudget, int payloadWidthIn = 0)
+		: bufMgr(bufMgrIn), prefix(filePrefix), nextRunNo(0), payloadWidth(payloadWidthIn), memoryPos(0)
+	{
+		entrySize = sizeof(RecordId) + SortKeySize<T>::value + payloadWidth;
+		entriesPerPage = Page::SIZE / entrySize;
+		runCapacity = std::max((std::size_t)1, memoryBudget / (sizeof(MemoryEntry) + payloadWidth));
+	}
+
+  /**
+   * Unpin any page still held by the merge and remove all temporary run files.
+   */
+	~ExternalSorter()
+	{
+		for (std::size_t i = 0; i < readers.size(); i++)
+		{
+			if (readers[i].page != NULL)
+			{
+				bufMgr->unPinPage(readers[i].run->file, readers[i].pageNo, false);
+			}
+		}
+		for (std::size_t i = 0; i < runs.size(); i++)
+		{
+			removeRun(runs[i]);
+		}
+	}
+
+  /**
+   * Add a pair to the sort. Spills a run once the memory budget is reached.
+   * @param pair		Pair to sort
+   * @param payload	payloadWidth bytes that go with the pair; NULL when there is no payload
+   */
+	void add(const RIDKeyPair<T> &pair, const char *payload = NULL)
+	{
+		MemoryEntry entry;
+		entry.pair = pair;
+		entry.payloadPos = memoryPayloads.size();
+		memory.push_back(entry);
+		if (payloadWidth > 0)
+		{
+			memoryPayloads.append(payload, payloadWidth);
+		}
+		if (memory.size() >= runCapacity)
+		{
+			spill();
+		}
+	}
+
+  /**
+   * Called once all pairs have been added, before the first call to next().
+   */
+	void finish()
+	{
+		std::sort(memory.begin(), memory.end());
+		if (!runs.empty())
+		{
+			if (!memory.empty())
+			{
+				spill();
+			}
+			// reduce the runs until one merge pass can read all of them at once
+			while (runs.size() > (std::size_t)EXTERNAL_SORT_MAX_FANIN)
+			{
+				std::vector<Run> group(runs.begin(), runs.begin() + EXTERNAL_SORT_MAX_FANIN);
+				runs.erase(runs.begin(), runs.begin() + EXTERNAL_SORT_MAX_FANIN);
+				startMerge(group);
+				Run merged = createRun();
+				RunWriter writer(this, merged);
+				RIDKeyPair<T> pair;
+				std::string payload(payloadWidth, '\0');
+				while (nextMerged(pair, &payload[0]))
+				{
+					writer.append(pair, payload.data());
+				}
+				writer.close();
+				for (std::size_t i = 0; i < group.size(); i++)
+				{
+					removeRun(group[i]);
+				}
+				runs.push_back(merged);
+			}
+			startMerge(runs);
+		}
+	}
+
+  /**
+   * Fetch the next pair in ascending order.
+   * @param pair	Next pair returned in this
+   * @param payload	NULL, or receives the payloadWidth bytes of the pair
+   * @return false once every pair has been returned
+   */
+	bool next(RIDKeyPair<T> &pair, char *payload = NULL)
+	{
+		if (runs.empty())
+		{
+			if (memoryPos == memory.size())
+			{
+				return false;
+			}
+			const MemoryEntry &entry = memory[memoryPos++];
+			pair = entry.pair;
+			if (payload != NULL && payloadWidth > 0)
+			{
+				memcpy(payload, memoryPayloads.data() + entry.payloadPos, payloadWidth);
+			}
+			return true;
+		}
+		return nextMerged(pair, payload);
+	}
+
+ private:
+
+  /**
+   * @brief A sorted run stored in a temporary BlobFile, starting at its first page.
+   */
+	struct Run {
+		BlobFile *file;
+		std::string name;
+		std::size_t count;
+	};
+
+  /**
+   * @brief Merge cursor over one run; keeps the page being read pinned.
+   */
+	struct RunReader {
+		Run *run;
+		std::size_t remaining;
+		PageId pageNo;
+		int indexInPage;
+		Page *page;
+		// payload of the reader's pair in the heap
+		std::string payload;
+	};
+
+  /**
+   * @brief A pair held in memory; its payload is in memoryPayloads at payloadPos.
+   */
+	struct MemoryEntry {
+		RIDKeyPair<T> pair;
+		std::size_t payloadPos;
+		bool operator<(const MemoryEntry &rhs) const
+		{
+			return pair < rhs.pair;
+		}
+	};
+
+  /**
+   * @brief Appends pairs to a new run, one page at a time.
+   */
+	class RunWriter {
+	 public:
+		RunWriter(ExternalSorter *sorterIn, Run &runIn)
+			: sorter(sorterIn), run(runIn), page(NULL), indexInPage(0)
+		{
+		}
+
+		void append(const RIDKeyPair<T> &pair, const char *payload)
+		{
+			if (page == NULL)
+			{
+				sorter->bufMgr->allocPage(run.file, pageNo, page);
+				indexInPage = 0;
+			}
+			char *dst = reinterpret_cast<char *>(page) + indexInPage * sorter->entrySize;
+			writeEntry(dst, pair);
+			memcpy(dst + sizeof(RecordId) + SortKeySize<T>::value, payload, sorter->payloadWidth);
+			run.count++;
+			if (++indexInPage == sorter->entriesPerPage)
+			{
+				sorter->bufMgr->unPinPage(run.file, pageNo, true);
+				page = NULL;
+			}
+		}
+
+		void close()
+		{
+			if (page != NULL)
+			{
+				sorter->bufMgr->unPinPage(run.file, pageNo, true);
+				page = NULL;
+			}
+			// push the run out of the buffer pool, it is not read until the merge
+			sorter->bufMgr->flushFile(run.file);
+		}
+
+	 private:
+		ExternalSorter *sorter;
+		Run &run;
+		PageId pageNo;
+		Page *page;
+		int indexInPage;
+	};
+
+	static void writeKey(char *dst, const int &key) { memcpy(dst, &key, sizeof(int)); }
+	static void writeKey(char *dst, const double &key) { memcpy(dst, &key, sizeof(double)); }
+	static void writeKey(char *dst, const std::string &key) { strncpy(dst, key.c_str(), STRINGSIZE); }
+	static void readKey(const char *src, int &key) { memcpy(&key, src, sizeof(int)); }
+	static void readKey(const char *src, double &key) { memcpy(&key, src, sizeof(double)); }
+	static void readKey(const char *src, std::string &key) { key.assign(src, strnlen(src, STRINGSIZE)); }
+
+	static void writeEntry(char *dst, const RIDKeyPair<T> &pair)
+	{
+		memcpy(dst, &pair.rid, sizeof(RecordId));
+		writeKey(dst + sizeof(RecordId), pair.key);
+	}
+
+	static void readEntry(const char *src, RIDKeyPair<T> &pair)
+	{
+		memcpy(&pair.rid, src, sizeof(RecordId));
+		readKey(src + sizeof(RecordId), pair.key);
+	}
+
+  /**
+   * Create an empty run file. Leftovers of an earlier, interrupted sort are removed first.
+   */
+	Run createRun()
+	{
+		std::ostringstream nameStr;
+		nameStr << prefix << ".run." << nextRunNo++;
+		Run run;
+		run.name = nameStr.str();
+		run.count = 0;
+		try
+		{
+			File::remove(run.name);
+		}
+		catch (FileNotFoundException &e)
+		{
+		}
+		run.file = new BlobFile(run.name, true);
+		return run;
+	}
+
+	void removeRun(Run &run)
+	{
+		bufMgr->flushFile(run.file);
+		delete run.file;
+		File::remove(run.name);
+	}
+
+  /**
+   * Sort the pairs held in memory and write them out as a new run.
+   */
+	void spill()
+	{
+		std::sort(memory.begin(), memory.end());
+		Run run = createRun();
+		RunWriter writer(this, run);
+		for (std::size_t i = 0; i < memory.size(); i++)
+		{
+			writer.append(memory[i].pair, memoryPayloads.data() + memory[i].payloadPos);
+		}
+		writer.close();
+		runs.push_back(run);
+		memory.clear();
+		memoryPayloads.clear();
+	}
+
+	void startMerge(std::vector<Run> &mergeRuns)
+	{
+		readers.clear();
+		heap = std::priority_queue<HeapEntry>();
+		for (std::size_t i = 0; i < mergeRuns.size(); i++)
+		{
+			RunReader reader;
+			reader.run = &mergeRuns[i];
+			reader.remaining = mergeRuns[i].count;
+			reader.pageNo = 1;
+			reader.indexInPage = 0;
+			reader.page = NULL;
+			readers.push_back(reader);
+		}
+		for (std::size_t i = 0; i < readers.size(); i++)
+		{
+			pushNext(i);
+		}
+	}
+
+  /**
+   * Move the head of the given reader into the heap, reading its next page if needed.
+   */
+	void pushNext(std::size_t readerNo)
+	{
+		RunReader &reader = readers[readerNo];
+		if (reader.remaining == 0)
+		{
+			return;
+		}
+		if (reader.page == NULL)
+		{
+			bufMgr->readPage(reader.run->file, reader.pageNo, reader.page);
+		}
+		HeapEntry entry;
+		const char *src = reinterpret_cast<char *>(reader.page) + reader.indexInPage * entrySize;
+		readEntry(src, entry.pair);
+		reader.payload.assign(src + sizeof(RecordId) + SortKeySize<T>::value, payloadWidth);
+		entry.readerNo = readerNo;
+		heap.push(entry);
+		reader.remaining--;
+		if (++reader.indexInPage == entriesPerPage || reader.remaining == 0)
+		{
+			bufMgr->unPinPage(reader.run->file, reader.pageNo, false);
+			reader.page = NULL;
+			reader.pageNo++;
+			reader.indexInPage = 0;
+		}
+	}
+
+	bool nextMerged(RIDKeyPair<T> &pair, char *payload)
+	{
+		if (heap.empty())
+		{
+			return false;
+		}
+		HeapEntry entry = heap.top();
+		heap.pop();
+		pair = entry.pair;
+		if (payload != NULL && payloadWidth > 0)
+		{
+			memcpy(payload, readers[entry.readerNo].payload.data(), payloadWidth);
+		}
+		pushNext(entry.readerNo);
+		return true;
+	}
+
+  /**
+   * @brief Smallest unread pair of a run; ordered so that the priority queue yields the smallest pair first.
+   */
+	struct HeapEntry {
+		RIDKeyPair<T> pair;
+		std::size_t readerNo;
+		bool operator<(const HeapEntry &rhs) const
+		{
+			return rhs.pair < pair;
+		}
+	};
+
+	BufMgr *bufMgr;
+	std::string prefix;
+	int nextRunNo;
+
+  /**
+   * Number of payload bytes of every pair.
+   */
+	int payloadWidth;
+
+  /**
+   * Serialized size of a pair and its payload inside a run page.
+   */
+	int entrySize;
+
+  /**
+   * Number of pairs stored in each run page.
+   */
+	int entriesPerPage;
+
+  /**
+   * Number of pairs held in memory before a run is spilled.
+   */
+	std::size_t runCapacity;
+
+  /**
+   * Pairs not yet spilled; after finish() the whole input when no run was spilled.
+   */
+	std::vector<MemoryEntry> memory;
+	std::string memoryPayloads;
+	std::size_t memoryPos;
+
+	std::vector<Run> runs;
+	std::vector<RunReader> readers;
+	std::priority_queue<HeapEntry> heap;
+};
+
+}
@@ -7,24 +7,37 @@
 
 #include "file.h"
 
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/file_format_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+File::OpenFileMap File::open_files_;
 File::CountMap File::open_counts_;
+std::mutex File::open_files_lock_;
+std::set<const File*> File::live_files_;
+
+OpenFile::~OpenFile() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -40,18 +53,17 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> guard(open_files_lock_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
-bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
+bool File::isLive(const File* file) {
+  std::lock_guard<std::mutex> guard(open_files_lock_);
+  return live_files_.count(file) > 0;
+}
 
-	return false;
+bool File::exists(const std::string& filename) {
+  return ::access(filename.c_str(), F_OK) == 0;
 }
 
 File::~File() {
@@ -69,63 +81,188 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
 
   if (create_new) {
     // File starts with 1 page (the header).
-    FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+    FileHeader header = {FILE_FORMAT, 1 /* num_pages */, 0 /* first_used_page */,
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */};
     writeHeader(header);
   }
 }
 
 void File::openIfNeeded(const bool create_new) {
+  std::lock_guard<std::mutex> guard(open_files_lock_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    open_file_ = open_files_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
+    int flags = O_RDWR;
     if (create_new) {
       // Error if we try to overwrite an existing file.
-      if (already_exists) {
+      if (exists(filename_)) {
         throw FileExistsException(filename_);
       }
       // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags |= O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
-      if (!already_exists) {
+      if (!exists(filename_)) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    std::shared_ptr<OpenFile> open_file(new OpenFile());
+    open_file->fd = ::open(filename_.c_str(), flags, 0644);
+    if (open_file->fd < 0) {
+      throw FileIOException(filename_, "open", errno);
+    }
+    open_file_ = open_file;
+    if (!create_new) {
+      // the only time the header is read from disk
+      readAt(&open_file_->header, sizeof(FileHeader), 0 /* pos */);
+      if (open_file_->header.format != FILE_FORMAT) {
+        open_file_.reset();
+        throw FileFormatException(filename_);
+      }
+    }
+    open_files_[filename_] = open_file_;
     open_counts_[filename_] = 1;
   }
+  live_files_.insert(this);
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> guard(open_files_lock_);
+  live_files_.erase(this);
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
+  if (open_counts_[filename_] == 0 && open_file_) {
+    // last user of the file: the cached header goes back to disk
+    try {
+      std::lock_guard<std::recursive_mutex> header_guard(open_file_->lock);
+      writeHeaderBack();
+    } catch (const BadgerDbException&) {
+      // close() runs from destructors and must not throw
+    }
+  }
+  open_file_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    open_files_.erase(filename_);
     open_counts_.erase(filename_);
   }
 }
 
+void File::readAt(void* buffer, const size_t len, const off_t position) const {
+  char* dst = static_cast<char*>(buffer);
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = ::pread(open_file_->fd, dst + done, len - done, position + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "pread", errno);
+    }
+    if (n == 0) {
+      break;  // end of file
+    }
+    done += n;
+  }
+}
+
+void File::writeAt(const void* buffer, const size_t len, const off_t position) {
+  const char* src = static_cast<const char*>(buffer);
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = ::pwrite(open_file_->fd, src + done, len - done, position + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "pwrite", errno);
+    }
+    done += n;
+  }
+}
+
+/**
+ * Drop the first n transferred bytes from an iovec array, returning the number
+ * of entries consumed completely.
+ */
+static int advanceVector(struct iovec* iov, int iovcnt, size_t n) {
+  int i = 0;
+  while (i < iovcnt && n >= iov[i].iov_len) {
+    n -= iov[i].iov_len;
+    ++i;
+  }
+  if (i < iovcnt) {
+    iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + n;
+    iov[i].iov_len -= n;
+  }
+  return i;
+}
+
+void File::readVectorAt(struct iovec* iov, int iovcnt, off_t position) const {
+  while (iovcnt > 0) {
+    ssize_t n = ::preadv(open_file_->fd, iov, iovcnt < IOV_MAX ? iovcnt : IOV_MAX, position);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "preadv", errno);
+    }
+    if (n == 0) {
+      break;  // end of file
+    }
+    position += n;
+    int consumed = advanceVector(iov, iovcnt, n);
+    iov += consumed;
+    iovcnt -= consumed;
+  }
+}
+
+void File::writeVectorAt(struct iovec* iov, int iovcnt, off_t position) {
+  while (iovcnt > 0) {
+    ssize_t n = ::pwritev(open_file_->fd, iov, iovcnt < IOV_MAX ? iovcnt : IOV_MAX, position);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "pwritev", errno);
+    }
+    position += n;
+    int consumed = advanceVector(iov, iovcnt, n);
+    iov += consumed;
+    iovcnt -= consumed;
+  }
+}
+
 FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
+  return open_file_->header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
+  open_file_->header = header;
+  open_file_->header_dirty = true;
+}
+
+void File::writeHeaderBack() {
+  if (open_file_->header_dirty) {
+    writeAt(&open_file_->header, sizeof(FileHeader), 0 /* pos */);
+    open_file_->header_dirty = false;
+  }
+}
+
+void File::sync() {
+  {
+    std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
+    writeHeaderBack();
+  }
+  if (::fdatasync(open_file_->fd) < 0) {
+    throw FileIOException(filename_, "fdatasync", errno);
+  }
 }
 
 
@@ -163,73 +300,46 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
   FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  // Allocation costs a constant number of page reads and writes: freed pages
+  // stay on the singly linked free list, whose head is the only free page ever
+  // needed, and the persisted last_used_page gives the tail of the used list.
+  // A free-page bitmap or extent map would only pay off for allocating runs of
+  // contiguous pages, which nothing asks for.
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
+    // Reuse the page at the head of the free list.
+    const PageHeader free_header = readPageHeader(header.first_free_page);
+    new_page_number = header.first_free_page;
+    header.first_free_page = free_header.next_page_number;
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
+  } else {
+    new_page_number = header.num_pages;
+    ++header.num_pages;
   }
-	else
-	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
+  new_page.set_page_number(new_page_number);
 
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
-    ++header.num_pages;
+  // Link the new page in at the tail of the used list.
+  if (header.first_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = new_page_number;
+  } else {
+    PageHeader tail_header = readPageHeader(header.last_used_page);
+    assert(tail_header.next_page_number == Page::INVALID_NUMBER);
+    tail_header.next_page_number = new_page_number;
+    writePageHeader(header.last_used_page, tail_header);
+    new_page.set_prev_page_number(header.last_used_page);
+    setNextPageNumber(header.last_used_page, new_page_number,
+                      true /* overwrite */);
   }
+  header.last_used_page = new_page_number;
+  setNextPageNumber(new_page_number, Page::INVALID_NUMBER,
+                    true /* overwrite */);
+
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
-  }
   writeHeader(header);
 
   return new_page;
@@ -247,59 +357,140 @@ Page PageFile::readPage(const PageId page_number) const {
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  struct iovec iov[2];
+  iov[0].iov_base = &page.header_;
+  iov[0].iov_len = sizeof(PageHeader);
+  iov[1].iov_base = &page.data_[0];
+  iov[1].iov_len = Page::DATA_SIZE;
+  readVectorAt(iov, 2, pagePosition(page_number));
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
+  if (page.isUsed()) {
+    setNextPageNumber(page_number, page.next_page_number(),
+                      false /* overwrite */);
+  }
 
   return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
 		// Page has been deleted since it was read.
 		throw InvalidPageException(new_page_number, filename_);
 	}
-	// Page on disk may have had its next page pointer updated since it was read;
-	// we don't modify that, but we do keep all the other modifications to the
-	// page header.
+	// Page on disk may have had its next and previous page pointers updated
+	// since it was read; we don't modify those, but we do keep all the other
+	// modifications to the page header.
 	const PageId next_page_number = header.next_page_number;
+	const PageId prev_page_number = header.prev_page_number;
 	header = new_page.header_;
 	header.next_page_number = next_page_number;
+	header.prev_page_number = prev_page_number;
 	writePage(new_page_number, header, new_page);
 }
 
+void PageFile::readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const {
+  if (pages.empty()) {
+    return;
+  }
+  const FileHeader header = readHeader();
+  if (first_page_number + pages.size() > header.num_pages) {
+    throw InvalidPageException(first_page_number + pages.size() - 1, filename_);
+  }
+
+  std::vector<struct iovec> iov(2 * pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    iov[2 * i].iov_base = &pages[i]->header_;
+    iov[2 * i].iov_len = sizeof(PageHeader);
+    iov[2 * i + 1].iov_base = &pages[i]->data_[0];
+    iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+  }
+  readVectorAt(&iov[0], iov.size(), pagePosition(first_page_number));
+
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    if (!pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    setNextPageNumber(first_page_number + i, pages[i]->next_page_number(),
+                      false /* overwrite */);
+  }
+}
+
+void PageFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+  if (pages.empty()) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
+
+  // keep the next and previous page numbers on disk, like writePage()
+  std::vector<PageHeader> headers(pages.size());
+  std::vector<struct iovec> iov(2 * pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    const PageId page_number = first_page_number + i;
+    headers[i] = readPageHeader(page_number);
+    if (headers[i].current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    const PageId next_page_number = headers[i].next_page_number;
+    const PageId prev_page_number = headers[i].prev_page_number;
+    headers[i] = pages[i]->header_;
+    headers[i].next_page_number = next_page_number;
+    headers[i].prev_page_number = prev_page_number;
+
+    iov[2 * i].iov_base = &headers[i];
+    iov[2 * i].iov_len = sizeof(PageHeader);
+    iov[2 * i + 1].iov_base = const_cast<char*>(&pages[i]->data_[0]);
+    iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+  }
+  writeVectorAt(&iov[0], iov.size(), pagePosition(first_page_number));
+}
+
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
   FileHeader header = readHeader();
+  if (page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+
+  const PageHeader existing_header = readPageHeader(page_number);
+  if (existing_header.current_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  const PageId next_page_number = existing_header.next_page_number;
+  const PageId prev_page_number = existing_header.prev_page_number;
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  // Unlink the page from its neighbours in the used list, or from the header
+  // if it is the head or the tail.
+  if (prev_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    PageHeader prev_header = readPageHeader(prev_page_number);
+    prev_header.next_page_number = next_page_number;
+    writePageHeader(prev_page_number, prev_header);
+    setNextPageNumber(prev_page_number, next_page_number,
+                      true /* overwrite */);
+  }
+  if (next_page_number == Page::INVALID_NUMBER) {
+    header.last_used_page = prev_page_number;
+  } else {
+    PageHeader next_header = readPageHeader(next_page_number);
+    next_header.prev_page_number = prev_page_number;
+    writePageHeader(next_page_number, next_header);
   }
+
+  setNextPageNumber(page_number, UNKNOWN_PAGE, true /* overwrite */);
+
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
+  Page existing_page;
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
-  }
   writePage(page_number, existing_page.header_, existing_page);
   writeHeader(header);
 }
@@ -313,22 +504,55 @@ FileIterator PageFile::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
+PageId PageFile::nextPageNumber(const PageId page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
+  std::vector<PageId>& next_pages = open_file_->next_pages;
+  if (page_number < next_pages.size() &&
+      next_pages[page_number] != UNKNOWN_PAGE) {
+    return next_pages[page_number];
+  }
+  // Read under the lock so that allocatePage and deletePage cannot change
+  // the link between the read and the update of the directory.
+  const PageId next_page_number = readPageHeader(page_number).next_page_number;
+  setNextPageNumber(page_number, next_page_number, true /* overwrite */);
+  return next_page_number;
+}
+
+void PageFile::setNextPageNumber(const PageId page_number,
+                                 const PageId next_page_number,
+                                 const bool overwrite) const {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
+  std::vector<PageId>& next_pages = open_file_->next_pages;
+  if (page_number >= next_pages.size()) {
+    const PageId unknown = UNKNOWN_PAGE;
+    next_pages.resize(page_number + 1, unknown);
+  }
+  if (overwrite || next_pages[page_number] == UNKNOWN_PAGE) {
+    next_pages[page_number] = next_page_number;
+  }
+}
+
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  struct iovec iov[2];
+  iov[0].iov_base = const_cast<PageHeader*>(&header);
+  iov[0].iov_len = sizeof(PageHeader);
+  iov[1].iov_base = const_cast<char*>(&new_page.data_[0]);
+  iov[1].iov_len = Page::DATA_SIZE;
+  writeVectorAt(iov, 2, pagePosition(page_number));
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readAt(&header, sizeof(PageHeader), pagePosition(page_number));
   return header;
 }
 
+void PageFile::writePageHeader(const PageId page_number,
+                               const PageHeader& header) {
+  writeAt(&header, sizeof(PageHeader), pagePosition(page_number));
+}
+
 
 
 
@@ -362,6 +586,7 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->lock);
   FileHeader header = readHeader();
 	Page new_page;
 
@@ -370,6 +595,7 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 	if (header.first_used_page == Page::INVALID_NUMBER) {
 		header.first_used_page = header.num_pages;
 	}
+	header.last_used_page = header.num_pages;
 
 	++header.num_pages;
 
@@ -381,15 +607,38 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readAt(&page, Page::SIZE, pagePosition(page_number));
 	return page;
 }
 
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	writeAt(&new_page, Page::SIZE, pagePosition(new_page_number));
+}
+
+void BlobFile::readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const {
+  if (pages.empty()) {
+    return;
+  }
+  std::vector<struct iovec> iov(pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    iov[i].iov_base = pages[i];
+    iov[i].iov_len = Page::SIZE;
+  }
+  readVectorAt(&iov[0], iov.size(), pagePosition(first_page_number));
+}
+
+void BlobFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+  if (pages.empty()) {
+    return;
+  }
+  std::vector<struct iovec> iov(pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    iov[i].iov_base = const_cast<Page*>(pages[i]);
+    iov[i].iov_len = Page::SIZE;
+  }
+  writeVectorAt(&iov[0], iov.size(), pagePosition(first_page_number));
 }
 
 //delePage should not be called for a blob_file, not supported
@@ -7,10 +7,14 @@
 
 #pragma once
 
-#include <fstream>
 #include <string>
 #include <map>
+#include <set>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #include "page.h"
 
@@ -18,10 +22,24 @@ namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief Stamp at the start of every file with the current on-disk layout.
+ *
+ * The layout changed when FileHeader gained last_used_page and PageHeader
+ * gained prev_page_number: both headers grew, which moves every page.  Files
+ * written before have no stamp and are refused instead of being misread.
+ */
+const std::uint32_t FILE_FORMAT = 0x42444202;
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
 struct FileHeader {
+  /**
+   * FILE_FORMAT for files with the current layout.
+   */
+  std::uint32_t format;
+
   /**
    * Number of pages allocated in the file.
    */
@@ -42,6 +60,12 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file, where new pages are linked
+   * into the used list.
+   */
+  PageId last_used_page;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -49,26 +73,74 @@ struct FileHeader {
    * @return  True if the other header is equal to this one.
    */
   bool operator==(const FileHeader& rhs) const {
-    return num_pages == rhs.num_pages &&
+    return format == rhs.format &&
+        num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page;
   }
 };
 
+/**
+ * @brief Descriptor of an opened file, shared by all File objects on it.
+ */
+struct OpenFile {
+  /**
+   * Descriptor of the UNIX file, closed when the last File object using it
+   * goes away.
+   */
+  int fd;
+
+  /**
+   * Serializes access to the cached header and the page directory, and
+   * operations that update the page list.  PageFile page writes also take
+   * it, since they read-modify-write the page header on disk.  Page reads
+   * take it only to record next page numbers, and BlobFile writes not at all.
+   */
+  std::recursive_mutex lock;
+
+  /**
+   * The file header, read from disk when the file is opened and written back
+   * by File::sync() and when the file is closed.
+   */
+  FileHeader header;
+
+  /**
+   * True if header has changed since it was last written to disk.
+   */
+  bool header_dirty;
+
+  /**
+   * Page directory of a PageFile: the next page number of each used page,
+   * indexed by page number, or PageFile::UNKNOWN_PAGE if the page has not
+   * been seen since the file was opened.  Filled by page reads and kept up to date by
+   * allocatePage and deletePage, so walking the page list needs no I/O for
+   * pages that were read before.  Guarded by lock.
+   */
+  std::vector<PageId> next_pages;
+
+  OpenFile() : fd(-1), header_dirty(false) {}
+  ~OpenFile();
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a descriptor of an underlying file on disk.  Files
+ * contain fixed-sized pages, and they never deallocate space (though they do
+ * reuse deleted pages if possible).  If multiple File objects refer to the same
+ * underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_files_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * Pages are read and written with positional I/O (pread/pwrite and their
+ * vectored forms), which needs no shared file offset, so several threads can
+ * read and write pages of the same file at once.  Writes are not flushed to
+ * stable storage individually.
+ * Opening and closing files is also safe from several threads.
  */
 
 
@@ -84,6 +156,8 @@ class File {
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileFormatException     If the file exists but does not have
+   *                                  the current layout (see FILE_FORMAT).
    */
   File(const std::string& name, const bool create_new);
 
@@ -103,6 +177,15 @@ class File {
    */
   static bool isOpen(const std::string& filename);
 
+  /**
+   * Returns true if the object is an open File that has not been closed or
+   * destroyed yet.  Lets the background flusher check that a File pointer
+   * it holds is still usable.
+   *
+   * @param file  File object to check.
+   */
+  static bool isLive(const File* file);
+
 
   /**
    * Returns true if the file exists and is open.
@@ -150,6 +233,28 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Reads consecutive pages with a single vectored read.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param pages               Where to read the pages to, one per page; they
+   *                            need not be contiguous in memory.
+   * @throws  InvalidPageException  If a page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const = 0;
+
+  /**
+   * Writes consecutive pages with a single vectored write.  Behaves like
+   * calling writePage() for each of them.
+   *
+   * @param first_page_number   Number of the first page to write.
+   * @param pages               Pages to write, one per page.
+   */
+  virtual void writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) = 0;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -164,6 +269,15 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Writes the cached file header back if it changed and flushes the file to
+   * stable storage.  Use it as a checkpoint; the header is otherwise only
+   * written when the last File object on the file is closed.
+   *
+   * @throws  FileIOException  If the write or the flush fails.
+   */
+  void sync();
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -172,66 +286,111 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  static off_t pagePosition(const PageId page_number) {
+    return sizeof(FileHeader) + ((off_t)(page_number - 1) * Page::SIZE);
   }
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileFormatException     If the file exists but does not have
+   *                                  the current layout (see FILE_FORMAT).
    */
   void openIfNeeded(const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <open_file_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header for this file, from the copy cached in memory.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Makes the given header the header for this file.  Only the copy cached in
+   * memory is updated; see sync().
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Writes the cached header to disk if it changed.  The caller holds the
+   * lock of the open file.
+   *
+   * @throws  FileIOException  If the write fails.
+   */
+  void writeHeaderBack();
+
+  /**
+   * Reads len bytes at the given position, looping over short reads.  Bytes
+   * past the end of the file are left untouched.
+   *
+   * @throws  FileIOException  If the read fails.
+   */
+  void readAt(void* buffer, const size_t len, const off_t position) const;
+
+  /**
+   * Writes len bytes at the given position, looping over short writes.
+   *
+   * @throws  FileIOException  If the write fails.
+   */
+  void writeAt(const void* buffer, const size_t len, const off_t position);
+
+  /**
+   * Vectored forms of readAt and writeAt.  The iovec array is modified.
+   *
+   * @throws  FileIOException  If the read or write fails.
+   */
+  void readVectorAt(struct iovec* iov, int iovcnt, off_t position) const;
+  void writeVectorAt(struct iovec* iov, int iovcnt, off_t position);
+
+  typedef std::map<std::string, std::shared_ptr<OpenFile> > OpenFileMap;
   typedef std::map<std::string, int> CountMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors of opened files.
    */
-  static StreamMap open_streams_;
+  static OpenFileMap open_files_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Protects the maps of opened files.
+   */
+  static std::mutex open_files_lock_;
+
+  /**
+   * File objects that are currently open; protected by open_files_lock_.
+   */
+  static std::set<const File*> live_files_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of the underlying filesystem object, shared with the other File
+   * objects on the same file.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<OpenFile> open_file_;
 
   friend class FileIterator;
 };
@@ -249,13 +408,15 @@ class PageFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_files_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileFormatException     If the file does not have the current
+   *                                  layout (see FILE_FORMAT).
    */
   static PageFile open(const std::string& filename);
 
@@ -268,6 +429,8 @@ class PageFile : public File {
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileFormatException     If the file exists but does not have
+   *                                  the current layout (see FILE_FORMAT).
    */
   PageFile(const std::string& name, const bool create_new);
 
@@ -326,6 +489,27 @@ class PageFile : public File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Reads consecutive pages with a single vectored read.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param pages               Where to read the pages to, one per page.
+   * @throws  InvalidPageException  If a page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page*>& pages) const;
+
+  /**
+   * Writes consecutive pages with a single vectored write, keeping the
+   * next and previous page numbers stored on disk like writePage().
+   *
+   * @param first_page_number   Number of the first page to write.
+   * @param pages               Pages to write, one per page.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -341,14 +525,42 @@ class PageFile : public File {
    */
   FileIterator end();
 
+  /**
+   * Returns the number of the used page after the given one.  Comes from
+   * the page directory; the page header is read from disk only if the page
+   * has not been read since the file was opened.
+   *
+   * @param page_number   Number of a used page.
+   * @return  Number of the next used page, Page::INVALID_NUMBER at the end.
+   */
+  PageId nextPageNumber(const PageId page_number) const;
+
+  /**
+   * Marks a page directory entry as not known yet.
+   */
+  static const PageId UNKNOWN_PAGE = 0xFFFFFFFF;
+
  private:
+  /**
+   * Records the next page number of a page in the page directory.  Unless
+   * overwrite is set, an entry that is already known is kept: it was set
+   * by allocatePage or deletePage and may be newer than the page read by a
+   * concurrent reader.
+   *
+   * @param page_number       Number of the page.
+   * @param next_page_number  Number of the page after it, or UNKNOWN_PAGE.
+   * @param overwrite         Replace an entry that is already known.
+   */
+  void setNextPageNumber(const PageId page_number,
+                         const PageId next_page_number,
+                         const bool overwrite) const;
 
   /**
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file is
+   * returned as a freshly initialized (free) page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -379,6 +591,15 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk.  No bounds checking is
+   * performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
   friend class FileIterator;
 };
 
@@ -395,13 +616,15 @@ class BlobFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_files_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileFormatException     If the file does not have the current
+   *                                  layout (see FILE_FORMAT).
    */
   static BlobFile open(const std::string& filename);
 
@@ -416,6 +639,8 @@ class BlobFile : public File {
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileFormatException     If the file exists but does not have
+   *                                  the current layout (see FILE_FORMAT).
    */
   BlobFile(const std::string& name, const bool create_new);
 
@@ -473,6 +698,24 @@ class BlobFile : public File {
    * @param page_number   Number of page to delete.
    */
   void deletePage(const PageId page_number);
+
+  /**
+   * Reads consecutive pages with a single vectored read.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param pages               Where to read the pages to, one per page.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page*>& pages) const;
+
+  /**
+   * Writes consecutive pages with a single vectored write.
+   *
+   * @param first_page_number   Number of the first page to write.
+   * @param pages               Pages to write, one per page.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
 };
 
 }
@@ -60,8 +60,7 @@ class FileIterator {
    */
 	inline FileIterator& operator++() {
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextPageNumber(current_page_number_);
 
 		return *this;
 	}
@@ -72,8 +71,7 @@ class FileIterator {
 		FileIterator tmp = *this;   // copy ourselves
 
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextPageNumber(current_page_number_);
 
 		return tmp;
 	}
@@ -94,6 +92,13 @@ class FileIterator {
         (current_page_number_ != rhs.current_page_number_);
   }
 
+  /**
+   * Returns the number of the page the iterator points to, without reading it.
+   *
+   * @return  Page number, Page::INVALID_NUMBER at the end of the file.
+   */
+  PageId page_number() const { return current_page_number_; }
+
   /**
    * Dereferences the iterator, returning a copy of the current page in the
    * file.
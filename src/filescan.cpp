@@ -5,11 +5,157 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <exception>
 #include "filescan.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 
 namespace badgerdb { 
 
+ScanFilter::ScanFilter(int attrByteOffsetIn, Datatype attrTypeIn, Operator opIn, const void *value)
+  : attrByteOffset(attrByteOffsetIn), attrType(attrTypeIn), op(opIn), intValue(0), doubleValue(0)
+{
+  if (attrType == INTEGER)
+    intValue = *(const int *)value;
+  else if (attrType == DOUBLE)
+    doubleValue = *(const double *)value;
+  else
+    stringValue = (const char *)value;
+}
+
+bool ScanFilter::matches(const RecordView &record) const
+{
+  if (record.length <= (std::size_t)attrByteOffset)
+  {
+    return false;
+  }
+  const char *attr = record.data + attrByteOffset;
+  const std::size_t available = record.length - attrByteOffset;
+
+  if (attrType == INTEGER)
+  {
+    if (available < sizeof(int))
+      return false;
+    int attrValue;
+    memcpy(&attrValue, attr, sizeof(int));
+    return compare(attrValue, intValue);
+  }
+  else if (attrType == DOUBLE)
+  {
+    if (available < sizeof(double))
+      return false;
+    double attrValue;
+    memcpy(&attrValue, attr, sizeof(double));
+    return compare(attrValue, doubleValue);
+  }
+  else
+  {
+    // compare in place, without building a string for the attribute
+    const std::size_t length = strnlen(attr, available);
+    int order = memcmp(attr, stringValue.data(), std::min(length, stringValue.size()));
+    if (order == 0)
+      order = length < stringValue.size() ? -1 : (length > stringValue.size() ? 1 : 0);
+    return compare(order, 0);
+  }
+}
+
+bool ScanFilter::matchAll(const std::vector<ScanFilter> &filters, const RecordView &record)
+{
+  for (std::size_t i = 0; i < filters.size(); i++)
+  {
+    if (!filters[i].matches(record))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// number of attribute values gathered before they are compared
+static const std::size_t FILTER_CHUNK = 64;
+
+template <class T>
+void ScanFilter::filterValues(const RecordView *records, std::size_t count, const T &value, unsigned char *matches) const
+{
+  T attrs[FILTER_CHUNK];
+  for (std::size_t first = 0; first < count; first += FILTER_CHUNK)
+  {
+    const std::size_t n = std::min(FILTER_CHUNK, count - first);
+    unsigned char *chunkMatches = matches + first;
+
+    // gather the attribute of every record; records too short to hold it never match
+    for (std::size_t i = 0; i < n; i++)
+    {
+      const RecordView &record = records[first + i];
+      if (record.length >= (std::size_t)attrByteOffset + sizeof(T))
+      {
+        memcpy(&attrs[i], record.data + attrByteOffset, sizeof(T));
+      }
+      else
+      {
+        attrs[i] = value;
+        chunkMatches[i] = 0;
+      }
+    }
+
+    // one loop per operator with no branch inside
+    switch (op)
+    {
+      case LT:
+        for (std::size_t i = 0; i < n; i++)
+          chunkMatches[i] &= attrs[i] < value;
+        break;
+      case LTE:
+        for (std::size_t i = 0; i < n; i++)
+          chunkMatches[i] &= attrs[i] <= value;
+        break;
+      case GTE:
+        for (std::size_t i = 0; i < n; i++)
+          chunkMatches[i] &= attrs[i] >= value;
+        break;
+      case GT:
+        for (std::size_t i = 0; i < n; i++)
+          chunkMatches[i] &= attrs[i] > value;
+        break;
+    }
+  }
+}
+
+void ScanFilter::filterBatch(const RecordView *records, std::size_t count, unsigned char *matches) const
+{
+  if (attrType == INTEGER)
+  {
+    filterValues(records, count, intValue, matches);
+  }
+  else if (attrType == DOUBLE)
+  {
+    filterValues(records, count, doubleValue, matches);
+  }
+  else
+  {
+    // strings have no fixed width to gather; compare the records still matching one by one
+    for (std::size_t i = 0; i < count; i++)
+    {
+      if (matches[i] && !this->matches(records[i]))
+        matches[i] = 0;
+    }
+  }
+}
+
+void ScanFilter::matchAll(const std::vector<ScanFilter> &filters, const RecordView *records, std::size_t count,
+                          unsigned char *matches)
+{
+  std::fill(matches, matches + count, 1);
+  for (std::size_t i = 0; i < filters.size(); i++)
+  {
+    filters[i].filterBatch(records, count, matches);
+  }
+}
+
 FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
 {
   file = new PageFile(name, false);	//dont create new file
@@ -17,6 +163,10 @@ FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
 	curDirtyFlag = false;
   curPage = NULL;
 	filePageIter = file->begin();
+	prefetchWindow = DEFAULT_PREFETCH_WINDOW;
+	pagesAhead = 0;
+	pageRecordPos = 0;
+	pageFiltered = false;
 }
 
 FileScan::~FileScan()
@@ -24,7 +174,7 @@ FileScan::~FileScan()
   // generally must unpin last page of the scan
   if (curPage != NULL)
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    bufMgr->unPinPage(file, filePageIter.page_number(), curDirtyFlag);
     curPage = NULL;
 		curDirtyFlag = false;
     filePageIter = file->begin();
@@ -35,73 +185,151 @@ FileScan::~FileScan()
 
 void FileScan::scanNext(RecordId& outRid)
 {
-  std::string rec;
+  if (scanNextBatch(&outRid, NULL, 1) == 0)
+  {
+    throw EndOfFileException();
+  }
+}
 
+int FileScan::scanNextBatch(RecordId *outRids, RecordView *outViews, int maxRecords)
+{
+  if (maxRecords <= 0)
+  {
+    // an empty batch could not be told from the end of the file
+    throw BadScanParamException();
+  }
   if (filePageIter == file->end())
-	{
-		throw EndOfFileException();
-	}
+  {
+    return 0;
+  }
 
-  // special case of the first record of the first page of the file
   if (curPage == NULL)
   {
-    // need to get the first page of the file
-		filePageIter = file->begin();
-    if(filePageIter == file->end())
-		{
-			throw EndOfFileException();
-		}
-	 
-		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
+    // special case of the first record of the first page of the file
+    if (!firstPage())
+    {
+      return 0;
+    }
+  }
+  else
+  {
+    // step past the last record returned
+    pageRecordIter++;
+    pageRecordPos++;
+  }
 
-		// get the first record off the page
-    pageRecordIter = curPage->begin(); 
+  // take records off the current page only, so that it is the only page pinned;
+  // pageRecordIter is left at the last record returned, for getRecord()
+  int count = 0;
+  PageIterator lastRecordIter;
+  std::size_t lastRecordPos = 0;
+  while (1)
+  {
+    while (pageRecordIter == curPage->end())
+    {
+      if (count > 0)
+      {
+        pageRecordIter = lastRecordIter;
+        pageRecordPos = lastRecordPos;
+        return count;
+      }
+      if (!nextPage())
+      {
+        return 0;
+      }
+    }
 
-		if(pageRecordIter != curPage->end()) 
-		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
+    // the filters are evaluated over the whole page at once
+    if (!filters.empty() && !pageFiltered)
+    {
+      filterPage();
+    }
 
-			outRid = pageRecordIter.getCurrentRecord();
-			return;
-		}
+    if (filters.empty() || pageMatches[pageRecordPos])
+    {
+      outRids[count] = pageRecordIter.getCurrentRecord();
+      if (outViews != NULL)
+      {
+        outViews[count] = pageRecordIter.view();
+      }
+      count++;
+      if (count == maxRecords)
+      {
+        return count;
+      }
+      lastRecordIter = pageRecordIter;
+      lastRecordPos = pageRecordPos;
+    }
+    pageRecordIter++;
+    pageRecordPos++;
   }
+}
 
-	// Loop, looking for a record that satisfied the predicate.
-	// First try and get the next record off the current page
-	pageRecordIter++;
-
-  while (pageRecordIter == curPage->end())
+void FileScan::filterPage()
+{
+  pageViews.clear();
+  for (PageIterator recordIter = curPage->begin(); recordIter != curPage->end(); recordIter++)
   {
-    // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
+    pageViews.push_back(recordIter.view());
+  }
+  pageMatches.resize(pageViews.size());
+  if (!pageViews.empty())
+  {
+    ScanFilter::matchAll(filters, &pageViews[0], pageViews.size(), &pageMatches[0]);
+  }
+  pageFiltered = true;
+}
 
-    filePageIter++;
-    if (filePageIter == file->end())
-    {
-      curPage = NULL;
-			throw EndOfFileException();
-    }
+bool FileScan::firstPage()
+{
+  // need to get the first page of the file
+	filePageIter = file->begin();
+  if (filePageIter == file->end())
+	{
+		return false;
+	}
+
+	// start reading ahead from the page after the first one
+	prefetchIter = filePageIter;
+	prefetchIter++;
+	pagesAhead = 0;
+	readAhead();
+
+	// read the first page of the file
+  bufMgr->readPage(file, filePageIter.page_number(), curPage);
+	curDirtyFlag = false;
+
+	// get the first record off the page
+  pageRecordIter = curPage->begin();
+  pageRecordPos = 0;
+  pageFiltered = false;
+  return true;
+}
 
-    // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+bool FileScan::nextPage()
+{
+  // unpin the current page
+  bufMgr->unPinPage(file, filePageIter.page_number(), curDirtyFlag);
+  curPage = NULL;
+  curDirtyFlag = false;
 
-    // get the first record off the page
-    pageRecordIter = curPage->begin(); 
+  filePageIter++;
+  if (filePageIter == file->end())
+  {
+    return false;
   }
+  if (pagesAhead > 0)
+    pagesAhead--;
+  readAhead();
 
-  // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
+  // read the next page of the file
+  bufMgr->readPage(file, filePageIter.page_number(), curPage);
 
-	// return rid of the record
-	outRid = pageRecordIter.getCurrentRecord();
-	return;
+  // get the first record off the page
+  pageRecordIter = curPage->begin();
+  pageRecordPos = 0;
+  pageFiltered = false;
+  return true;
 }
 
 // returns pointer to the current record.  page is left pinned
@@ -111,10 +339,172 @@ std::string FileScan::getRecord()
   return *pageRecordIter;
 }
 
+// returns a view of the current record in the pinned page, no copy is made
+RecordView FileScan::getRecordView()
+{
+  return pageRecordIter.view();
+}
+
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
   curDirtyFlag = true;
 }
 
+void FileScan::addFilter(int attrByteOffset, Datatype attrType, Operator op, const void *value)
+{
+  filters.push_back(ScanFilter(attrByteOffset, attrType, op, value));
+  pageFiltered = false;
+}
+
+void FileScan::clearFilters()
+{
+  filters.clear();
+  pageFiltered = false;
+}
+
+void FileScan::setPrefetchWindow(std::uint32_t pages)
+{
+  prefetchWindow = pages;
+}
+
+void FileScan::readAhead()
+{
+  if (pagesAhead > prefetchWindow / 2)
+    return;
+
+  std::vector<PageId> pageNos;
+  while (pagesAhead < prefetchWindow && prefetchIter != file->end())
+  {
+    pageNos.push_back(prefetchIter.page_number());
+    prefetchIter++;
+    pagesAhead++;
+  }
+  bufMgr->prefetchPages(file, pageNos);
+}
+
+//----------------------------------------
+// ParallelFileScan
+//----------------------------------------
+
+ParallelFileScan::ParallelFileScan(const std::string &name, BufMgr *bufferMgr, int numWorkersIn)
+{
+  file = new PageFile(name, false);	//dont create new file
+  bufMgr = bufferMgr;
+  numWorkers = std::max(1, numWorkersIn);
+}
+
+ParallelFileScan::~ParallelFileScan()
+{
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void ParallelFileScan::addFilter(int attrByteOffset, Datatype attrType, Operator op, const void *value)
+{
+  filters.push_back(ScanFilter(attrByteOffset, attrType, op, value));
+}
+
+void ParallelFileScan::clearFilters()
+{
+  filters.clear();
+}
+
+void ParallelFileScan::scan(const RecordFunction &process)
+{
+  // the page list comes from the file's page directory, without reading the pages
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file->begin(); iter != file->end(); iter++)
+  {
+    pageNos.push_back(iter.page_number());
+  }
+
+  std::vector<std::thread> workers;
+  std::vector<std::exception_ptr> errors(numWorkers);
+  for (int worker = 0; worker < numWorkers; worker++)
+  {
+    const std::size_t begin = pageNos.size() * worker / numWorkers;
+    const std::size_t end = pageNos.size() * (worker + 1) / numWorkers;
+    workers.push_back(std::thread([&, worker, begin, end]() {
+      try
+      {
+        scanRange(worker, pageNos, begin, end, process);
+      }
+      catch (...)
+      {
+        errors[worker] = std::current_exception();
+      }
+    }));
+  }
+  for (int worker = 0; worker < numWorkers; worker++)
+  {
+    workers[worker].join();
+  }
+  for (int worker = 0; worker < numWorkers; worker++)
+  {
+    if (errors[worker])
+    {
+      std::rethrow_exception(errors[worker]);
+    }
+  }
+}
+
+std::vector<RecordId> ParallelFileScan::collectRecordIds()
+{
+  std::vector<std::vector<RecordId> > found(numWorkers);
+  scan([&found](int worker, const RecordId &rid, const RecordView &record) {
+    found[worker].push_back(rid);
+  });
+
+  // the ranges are in page list order, so the workers' results are too
+  std::vector<RecordId> rids;
+  for (int worker = 0; worker < numWorkers; worker++)
+  {
+    rids.insert(rids.end(), found[worker].begin(), found[worker].end());
+  }
+  return rids;
+}
+
+void ParallelFileScan::scanRange(int worker, const std::vector<PageId> &pageNos, std::size_t begin, std::size_t end,
+                                 const RecordFunction &process)
+{
+  std::vector<RecordView> views;
+  std::vector<RecordId> rids;
+  std::vector<unsigned char> matches;
+  for (std::size_t i = begin; i < end; i++)
+  {
+    Page *page;
+    bufMgr->readPage(file, pageNos[i], page);
+    try
+    {
+      // evaluate the filters over the whole page, then hand over the records that passed
+      views.clear();
+      rids.clear();
+      for (PageIterator recordIter = page->begin(); recordIter != page->end(); recordIter++)
+      {
+        views.push_back(recordIter.view());
+        rids.push_back(recordIter.getCurrentRecord());
+      }
+      matches.assign(views.size(), 1);
+      if (!filters.empty() && !views.empty())
+      {
+        ScanFilter::matchAll(filters, &views[0], views.size(), &matches[0]);
+      }
+      for (std::size_t r = 0; r < views.size(); r++)
+      {
+        if (matches[r])
+        {
+          process(worker, rids[r], views[r]);
+        }
+      }
+    }
+    catch (...)
+    {
+      bufMgr->unPinPage(file, pageNos[i], false);
+      throw;
+    }
+    bufMgr->unPinPage(file, pageNos[i], false);
+  }
+}
+
 }
@@ -9,6 +9,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <functional>
 #include "types.h"
 #include "page.h"
 #include "buffer.h"
@@ -17,6 +19,76 @@
 
 namespace badgerdb {
 
+/**
+ * @brief Number of records callers of FileScan::scanNextBatch ask for at a time.
+ */
+const int SCAN_BATCH_SIZE = 256;
+
+/**
+ * @brief Comparison of the attribute at a fixed offset in a record with a constant, evaluated on
+ * the record bytes in the page.
+ */
+class ScanFilter
+{
+ public:
+  /**
+   * @param attrByteOffset  Offset of the attribute in the record
+   * @param attrType        Type of the attribute; a STRING attribute is NUL-terminated
+   * @param op              Comparison, attribute op value
+   * @param value           Pointer to the int, the double or the NUL-terminated string compared with
+   */
+  ScanFilter(int attrByteOffset, Datatype attrType, Operator op, const void *value);
+
+  /**
+   * @return true if the record satisfies the comparison; false also if it is too short to hold
+   * the attribute
+   */
+  bool matches(const RecordView &record) const;
+
+  /**
+   * @return true if the record satisfies every filter of the list
+   */
+  static bool matchAll(const std::vector<ScanFilter> &filters, const RecordView &record);
+
+  /**
+   * Evaluate every filter of the list over a batch of records, such as all the records of a page:
+   * matches[i] is set to 1 if records[i] satisfies them all and to 0 otherwise. Numeric attributes
+   * are gathered into a small array and compared in one branch-free loop per filter, which the
+   * compiler can vectorize, instead of one call and one branch per record.
+   */
+  static void matchAll(const std::vector<ScanFilter> &filters, const RecordView *records, std::size_t count,
+                       unsigned char *matches);
+
+ private:
+  /**
+   * Clear matches[i] for every record of the batch that does not satisfy the comparison
+   */
+  void filterBatch(const RecordView *records, std::size_t count, unsigned char *matches) const;
+
+  template <class T>
+  void filterValues(const RecordView *records, std::size_t count, const T &value, unsigned char *matches) const;
+
+  template <class T>
+  bool compare(const T &attr, const T &value) const
+  {
+    switch (op)
+    {
+      case LT: return attr < value;
+      case LTE: return attr <= value;
+      case GTE: return attr >= value;
+      case GT: return attr > value;
+    }
+    return false;
+  }
+
+  int attrByteOffset;
+  Datatype attrType;
+  Operator op;
+  int intValue;
+  double doubleValue;
+  std::string stringValue;
+};
+
 /**
  * @brief This class is used to sequentially scan records in a relation.
  */
@@ -31,12 +103,49 @@ class FileScan
   //return RecordId of next record that satisfies the scan 
   void scanNext(RecordId& outRid);
 
+  /**
+   * Return up to maxRecords of the next records of the scan at once. The records all come from
+   * one page, which stays pinned until the next call, and the views (if outViews is not NULL)
+   * point into it. Afterwards getRecord() returns the last record of the batch.
+   *
+   * @param outRids     Array of at least maxRecords record ids, filled in
+   * @param outViews    Array of at least maxRecords record views, filled in, or NULL
+   * @param maxRecords  Maximum number of records to return
+   * @return Number of records returned, 0 once the end of the file is reached
+   * @throws BadScanParamException If maxRecords is not positive
+   */
+  int scanNextBatch(RecordId *outRids, RecordView *outViews, int maxRecords);
+
   //read current record, returning pointer and length
   std::string getRecord();
 
+  /**
+   * View of the current record, pointing into the pinned page of the scan.
+   * Valid until the next call to scanNext.
+   */
+  RecordView getRecordView();
+
   //marks current page of scan dirty
   void markDirty();
 
+  /**
+   * Only return records whose attribute satisfies the comparison; filters added this way must
+   * all be satisfied. Records are tested in the page and the others are skipped without being
+   * copied. See ScanFilter for the parameters.
+   */
+  void addFilter(int attrByteOffset, Datatype attrType, Operator op, const void *value);
+
+  /**
+   * Drop the filters, so that the scan returns every record again
+   */
+  void clearFilters();
+
+  /**
+   * Set the number of pages the scan asks the buffer manager to read ahead of the current page
+   * along the file's page list; 0 turns read-ahead off. Defaults to DEFAULT_PREFETCH_WINDOW.
+   */
+  void setPrefetchWindow(std::uint32_t pages);
+
  private:
   /**
    * File which is being scanned.
@@ -56,10 +165,144 @@ class FileScan
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
+  /**
+   * First page of the file not yet handed to the buffer manager for read-ahead
+   */
+  FileIterator  prefetchIter;
+
+  /**
+   * Number of pages to keep requested ahead of the current page
+   */
+  std::uint32_t prefetchWindow;
+
+  /**
+   * Number of pages after the current one already requested
+   */
+  std::uint32_t pagesAhead;
+
+  /**
+   * Pin the first page of the file and point pageRecordIter at its first record
+   * @return false if the file has no pages
+   */
+  bool firstPage();
+
+  /**
+   * Unpin the current page, pin the next one and point pageRecordIter at its first record
+   * @return false at the end of the file, with no page pinned
+   */
+  bool nextPage();
+
+  /**
+   * Top up the pages requested ahead of the current page once half of them have been consumed
+   */
+  void readAhead();
+
+  /**
+   * Filters every returned record satisfies
+   */
+  std::vector<ScanFilter> filters;
+
+  /**
+   * Views of the records of the current page and whether each one satisfies the filters, in
+   * page order; filled by filterPage() when the scan has filters
+   */
+  std::vector<RecordView> pageViews;
+  std::vector<unsigned char> pageMatches;
+
+  /**
+   * Position of pageRecordIter among the records of the current page
+   */
+  std::size_t pageRecordPos;
+
+  /**
+   * True once pageMatches holds the current page evaluated with the current filters
+   */
+  bool pageFiltered;
+
+  /**
+   * Evaluate the filters over every record of the current page at once, into pageMatches
+   */
+  void filterPage();
+
   /**
    * True if page has been updated
    */
   bool  	      curDirtyFlag;
 };
 
+/**
+ * @brief Scans the records of a relation with several worker threads at once.
+ *
+ * The used pages of the file, in page list order, are split into one contiguous range per worker.
+ * Each worker pins its pages one at a time through the buffer manager, which must therefore be
+ * shared safely between threads, and hands every record that passes the filters to the caller.
+ */
+class ParallelFileScan
+{
+ public:
+  /**
+   * Called for every record from the worker that found it; calls from different workers run
+   * concurrently. The record view points into the pinned page and is only valid during the call.
+   */
+  typedef std::function<void(int worker, const RecordId &rid, const RecordView &record)> RecordFunction;
+
+  ParallelFileScan(const std::string &name, BufMgr *bufMgr, int numWorkers);
+
+  ~ParallelFileScan();
+
+  /**
+   * Same as FileScan::addFilter
+   */
+  void addFilter(int attrByteOffset, Datatype attrType, Operator op, const void *value);
+
+  /**
+   * Same as FileScan::clearFilters
+   */
+  void clearFilters();
+
+  /**
+   * Scan the whole relation and return when every worker is done. The first exception thrown by
+   * a worker, or by the function, is rethrown here.
+   *
+   * @param process  Function called for every record
+   */
+  void scan(const RecordFunction &process);
+
+  /**
+   * Scan the whole relation and merge the record ids found by the workers.
+   *
+   * @return Record ids of the records that pass the filters, in page list order
+   */
+  std::vector<RecordId> collectRecordIds();
+
+  int getNumWorkers() const { return numWorkers; }
+
+ private:
+  /**
+   * Process the pages in [begin, end) of pageNos as the given worker
+   */
+  void scanRange(int worker, const std::vector<PageId> &pageNos, std::size_t begin, std::size_t end,
+                 const RecordFunction &process);
+
+  /**
+   * File which is being scanned.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance shared by the workers.
+   */
+  BufMgr        *bufMgr;
+
+  /**
+   * Number of worker threads
+   */
+  int           numWorkers;
+
+  /**
+   * Filters every returned record satisfies
+   */
+  std::vector<ScanFilter> filters;
+};
+
 }
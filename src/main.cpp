@@ -6,19 +6,26 @@
  */
 
 #include <vector>
+#include <fstream>
+#include <algorithm>
+#include <thread>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "node_search.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
+#include "exceptions/file_format_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -68,12 +75,36 @@ void createRelationForward();
 void createRelationBackward();
 void createRelationRandom();
 void createRelationnonConsecutiveKey();
+void createRelationDuplicateKeys(int copies);
 void intTests();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 void indexTests();
 void indexReopenTest();
 void nonConsecutiveKeyTest();
 void nonConsecutiveTest();
+void fillFactorTest();
+void externalSortTest();
+void concurrentBufMgrTest();
+void replacementPolicyTest();
+void flusherTest();
+void prefetchTest();
+void vectoredIOTest();
+void fileHeaderTest();
+void allocatePageTest();
+void pageDirectoryTest();
+void recordViewTest();
+void scanBatchTest();
+void scanFilterTest();
+void parallelScanTest();
+void nodeSearchTest();
+void indexCursorTest();
+void indexScanBatchTest();
+void indexOnlyScanTest();
+void coveringIndexTest();
+void lookupTest();
+void appendInsertTest();
+void descendingInsertTest();
+void duplicateKeyScanTest();
 void doubleTests();
 int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
 void stringTests();
@@ -184,6 +215,34 @@ int main(int argc, char **argv)
 
 	}
 	nonConsecutiveKeyTest();
+	try {
+		File::remove(intIndexName);
+	} catch(const FileNotFoundException &e) {
+
+	}
+	fillFactorTest();
+	externalSortTest();
+	concurrentBufMgrTest();
+	replacementPolicyTest();
+	flusherTest();
+	prefetchTest();
+	vectoredIOTest();
+	fileHeaderTest();
+	allocatePageTest();
+	pageDirectoryTest();
+	recordViewTest();
+	scanBatchTest();
+	scanFilterTest();
+	parallelScanTest();
+	nodeSearchTest();
+	indexCursorTest();
+	indexScanBatchTest();
+	indexOnlyScanTest();
+	coveringIndexTest();
+	lookupTest();
+	appendInsertTest();
+	descendingInsertTest();
+	duplicateKeyScanTest();
 
   return 1;
 }
@@ -436,6 +495,55 @@ void createRelationnonConsecutiveKey()
 
 	file1->writePage(new_page_number, new_page);
 }
+
+// -----------------------------------------------------------------------------
+// createRelationDuplicateKeys
+// -----------------------------------------------------------------------------
+
+void createRelationDuplicateKeys(int copies)
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert runs of tuples sharing a key into the relation.
+  for(int i = 0; i < relationSize; i++ )
+	{
+    sprintf(record1.s, "%05d string record", i / copies);
+    record1.i = i / copies;
+    record1.d = (double)(i / copies);
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
 // -----------------------------------------------------------------------------
 // indexTests
 // -----------------------------------------------------------------------------
@@ -585,6 +693,1510 @@ void nonConsecutiveTest()
 	checkPassFail(intScan(&index,996*5,GT,1001*5,LT), 4)
 }
 
+void fillFactorTest()
+{
+	// Sparse pages make the bulk loader build a tree with several non-leaf levels
+	std::cout << "--------------------" << std::endl;
+	std::cout << "fillFactorTest" << std::endl;
+	createRelationForward();
+	{
+		BTreeBuildOptions options;
+		options.fillFactor = 0.01;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+		checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(intScan(&index,-1000,GTE,6000,LT), 5000)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void externalSortTest()
+{
+	// A tiny sort budget forces the index build to spill many runs and merge them in several passes
+	std::cout << "--------------------" << std::endl;
+	std::cout << "externalSortTest" << std::endl;
+	createRelationRandom();
+	BTreeBuildOptions options;
+	options.sortMemoryBudget = 2048;
+	if (testNum == 1)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,-1000,GTE,6000,LT), 5000)
+		}
+		File::remove(intIndexName);
+	}
+	else if (testNum == 2)
+	{
+		{
+			BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+			checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+			checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+		}
+		File::remove(doubleIndexName);
+	}
+	else if (testNum == 3)
+	{
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+			checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+			checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+		}
+		File::remove(stringIndexName);
+	}
+	deleteRelation();
+}
+
+void concurrentBufMgrTest()
+{
+	// Several threads read and update pages of a small, partitioned pool; pages are evicted and
+	// re-read while other threads hold them pinned
+	std::cout << "--------------------" << std::endl;
+	std::cout << "concurrentBufMgrTest" << std::endl;
+	const std::string fileName = "relA.concurrent";
+	const int numPages = 64;
+	const int numThreads = 4;
+	const int rounds = 200;
+	try
+	{
+		File::remove(fileName);
+	}
+	catch(const FileNotFoundException &)
+	{
+	}
+	{
+		BlobFile file(fileName, true);
+		BufMgr *pool = new BufMgr(16, 4);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page *page;
+			pool->allocPage(&file, pageNo, page);
+			memset(reinterpret_cast<char *>(page), 0, Page::SIZE);
+			pool->unPinPage(&file, pageNo, true);
+		}
+
+		// every thread increments its own counter slot on every page
+		std::vector<std::thread> threads;
+		for (int t = 0; t < numThreads; t++)
+		{
+			threads.push_back(std::thread([&, t]() {
+				for (int r = 0; r < rounds; r++)
+				{
+					PageId pageNo = 1 + (r * 7 + t) % numPages;
+					Page *page;
+					pool->readPage(&file, pageNo, page);
+					pool->latchPage(page, true);
+					reinterpret_cast<int *>(page)[t]++;
+					pool->unlatchPage(page, true);
+					pool->unPinPage(&file, pageNo, true);
+				}
+			}));
+		}
+		for (int t = 0; t < numThreads; t++)
+		{
+			threads[t].join();
+		}
+
+		int total = 0;
+		for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+		{
+			Page *page;
+			pool->readPage(&file, pageNo, page);
+			for (int t = 0; t < numThreads; t++)
+			{
+				total += reinterpret_cast<int *>(page)[t];
+			}
+			pool->unPinPage(&file, pageNo, false);
+		}
+		checkPassFail(total, numThreads * rounds)
+		pool->flushFile(&file);
+		delete pool;
+	}
+	File::remove(fileName);
+}
+
+void replacementPolicyTest()
+{
+	// A few hot pages are looked up while a scan sweeps a file four times the size of the pool.
+	// LRU-K and 2Q must keep the hot pages; every policy must return the right pages.
+	std::cout << "--------------------" << std::endl;
+	std::cout << "replacementPolicyTest" << std::endl;
+	const std::string fileName = "relA.policy";
+	const int numPages = 64;
+	const int numHot = 4;
+	const ReplacementPolicyType policies[] = {CLOCK_POLICY, LRU_K_POLICY, TWO_Q_POLICY};
+	for (int p = 0; p < 3; p++)
+	{
+		try
+		{
+			File::remove(fileName);
+		}
+		catch(const FileNotFoundException &)
+		{
+		}
+		{
+			BlobFile file(fileName, true);
+			BufMgr *pool = new BufMgr(16, 1, policies[p]);
+			for (int i = 0; i < numPages; i++)
+			{
+				PageId pageNo;
+				Page *page;
+				pool->allocPage(&file, pageNo, page);
+				reinterpret_cast<int *>(page)[0] = pageNo;
+				pool->unPinPage(&file, pageNo, true);
+			}
+
+			int hotHits = 0;
+			int correct = 0;
+			for (int round = 0; round < 3; round++)
+			{
+				for (PageId pageNo = numHot + 1; pageNo <= numPages; pageNo++)
+				{
+					Page *page;
+					PageId hotNo = 1 + pageNo % numHot;
+					pool->clearBufStats();
+					pool->readPage(&file, hotNo, page);
+					correct += reinterpret_cast<int *>(page)[0] == (int)hotNo;
+					pool->unPinPage(&file, hotNo, false);
+					// the first rounds warm the pool up
+					if (round == 2)
+						hotHits += pool->getBufStats().hits;
+
+					pool->readPage(&file, pageNo, page);
+					correct += reinterpret_cast<int *>(page)[0] == (int)pageNo;
+					pool->unPinPage(&file, pageNo, false);
+				}
+			}
+			checkPassFail(correct, 3 * 2 * (numPages - numHot))
+			if (policies[p] != CLOCK_POLICY)
+			{
+				checkPassFail(hotHits, numPages - numHot)
+			}
+			pool->flushFile(&file);
+			delete pool;
+		}
+		File::remove(fileName);
+	}
+}
+
+void flusherTest()
+{
+	// The background flusher must write every dirty, unpinned page back without any eviction
+	std::cout << "--------------------" << std::endl;
+	std::cout << "flusherTest" << std::endl;
+	const std::string fileName = "relA.flusher";
+	const int numPages = 16;
+	try
+	{
+		File::remove(fileName);
+	}
+	catch(const FileNotFoundException &)
+	{
+	}
+	{
+		BlobFile file(fileName, true);
+		// twice as many frames as pages, so no partition has to evict a page
+		BufMgr *pool = new BufMgr(2 * numPages, 2);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page *page;
+			pool->allocPage(&file, pageNo, page);
+			reinterpret_cast<int *>(page)[0] = pageNo;
+			pool->unPinPage(&file, pageNo, true);
+		}
+
+		BufFlusherOptions options;
+		options.pagesPerSecond = 0;
+		options.cleanTarget = 1.0;
+		options.intervalMs = 1;
+		pool->startFlusher(options);
+		for (int wait = 0; wait < 5000 && pool->getBufStats().flusherwrites < numPages; wait++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		pool->stopFlusher();
+		checkPassFail(pool->getBufStats().flusherwrites, numPages)
+
+		// the pages are on disk even though the buffer pool still holds them
+		int correct = 0;
+		for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+		{
+			Page page = file.readPage(pageNo);
+			correct += reinterpret_cast<int *>(&page)[0] == (int)pageNo;
+		}
+		checkPassFail(correct, numPages)
+		pool->flushFile(&file);
+		checkPassFail(pool->getBufStats().diskwrites, numPages)
+		delete pool;
+	}
+	File::remove(fileName);
+}
+
+void prefetchTest()
+{
+	// Pages requested with prefetchPages() must end up buffered, and a FileScan must read ahead
+	// without changing what it returns
+	std::cout << "--------------------" << std::endl;
+	std::cout << "prefetchTest" << std::endl;
+	const std::string fileName = "relA.prefetch";
+	const int numPages = 16;
+	try
+	{
+		File::remove(fileName);
+	}
+	catch(const FileNotFoundException &)
+	{
+	}
+	{
+		BlobFile file(fileName, true);
+		BufMgr *pool = new BufMgr(2 * numPages, 2);
+		std::vector<PageId> pageNos;
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page *page;
+			pool->allocPage(&file, pageNo, page);
+			pool->unPinPage(&file, pageNo, true);
+			pageNos.push_back(pageNo);
+		}
+		pool->flushFile(&file);
+
+		pool->clearBufStats();
+		pool->prefetchPages(&file, pageNos);
+		for (int wait = 0; wait < 5000 && pool->getBufStats().prefetchreads < numPages; wait++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		checkPassFail(pool->getBufStats().prefetchreads, numPages)
+		for (int i = 0; i < numPages; i++)
+		{
+			Page *page;
+			pool->readPage(&file, pageNos[i], page);
+			pool->unPinPage(&file, pageNos[i], false);
+		}
+		checkPassFail(pool->getBufStats().hits, numPages)
+		pool->flushFile(&file);
+		delete pool;
+	}
+	File::remove(fileName);
+
+	createRelationForward();
+	bufMgr->flushFile(file1);
+	bufMgr->clearBufStats();
+	int count = 0;
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while (1)
+			{
+				fscan.scanNext(scanRid);
+				count++;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	}
+	checkPassFail(count, relationSize)
+	bool readAhead = bufMgr->getBufStats().prefetchreads > 0;
+	checkPassFail(readAhead, true)
+	deleteRelation();
+}
+
+void vectoredIOTest()
+{
+	// Pages read and written in batches must match the pages written one at a time, and batch
+	// writes must leave the page list alone
+	std::cout << "--------------------" << std::endl;
+	std::cout << "vectoredIOTest" << std::endl;
+	const std::string fileName = "relA.vectored";
+	const int numPages = 8;
+	try
+	{
+		File::remove(fileName);
+	}
+	catch(const FileNotFoundException &)
+	{
+	}
+	{
+		PageFile file = PageFile::create(fileName);
+		PageId firstPageNo = Page::INVALID_NUMBER;
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			if (i == 0)
+				firstPageNo = pageNo;
+			page.insertRecord(std::to_string(i));
+			file.writePage(pageNo, page);
+		}
+
+		std::vector<Page> pages(numPages);
+		std::vector<Page*> readTargets;
+		std::vector<const Page*> writeSources;
+		for (int i = 0; i < numPages; i++)
+		{
+			readTargets.push_back(&pages[i]);
+			writeSources.push_back(&pages[i]);
+		}
+		file.readPages(firstPageNo, readTargets);
+		int correct = 0;
+		for (int i = 0; i < numPages; i++)
+		{
+			correct += pages[i].getRecord(RecordId{(PageId)(firstPageNo + i), 1}) == std::to_string(i);
+			pages[i].insertRecord(std::to_string(i + numPages));
+		}
+		checkPassFail(correct, numPages)
+
+		file.writePages(firstPageNo, writeSources);
+		correct = 0;
+		int listed = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); iter++)
+		{
+			Page page = *iter;
+			int i = page.page_number() - firstPageNo;
+			correct += page.getRecord(RecordId{page.page_number(), 2}) == std::to_string(i + numPages);
+			listed++;
+		}
+		checkPassFail(correct, numPages)
+		checkPassFail(listed, numPages)
+	}
+	File::remove(fileName);
+}
+
+/**
+ * Number of pages recorded in the header on disk, bypassing the File object.
+ */
+PageId diskNumPages(const std::string &fileName)
+{
+	FileHeader header = {0, 0, 0, 0, 0, 0};
+	std::ifstream in(fileName.c_str(), std::ios::binary);
+	in.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+	return header.num_pages;
+}
+
+void fileHeaderTest()
+{
+	// The header is kept in memory and only reaches the disk on sync() and close
+	std::cout << "--------------------" << std::endl;
+	std::cout << "fileHeaderTest" << std::endl;
+	const std::string fileName = "relA.header";
+	const int numPages = 4;
+	try
+	{
+		File::remove(fileName);
+	}
+	catch(const FileNotFoundException &)
+	{
+	}
+	{
+		PageFile file = PageFile::create(fileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+		bool stale = diskNumPages(fileName) != (PageId)(numPages + 1);
+		checkPassFail(stale, true)
+		file.sync();
+		checkPassFail(diskNumPages(fileName), (PageId)(numPages + 1))
+
+		PageId pageNo;
+		file.allocatePage(pageNo);
+	}
+	checkPassFail(diskNumPages(fileName), (PageId)(numPages + 2))
+	{
+		PageFile file = PageFile::open(fileName);
+		int listed = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); iter++)
+		{
+			listed++;
+		}
+		checkPassFail(listed, numPages + 1)
+	}
+	File::remove(fileName);
+
+	// a file from before the format stamp, whose header starts with the page count, is refused
+	{
+		std::ofstream out(fileName.c_str(), std::ios::binary);
+		PageId oldHeader[4] = {1, 0, 0, 0};
+		out.write(reinterpret_cast<const char*>(oldHeader), sizeof(oldHeader));
+	}
+	bool refused = false;
+	try
+	{
+		PageFile file = PageFile::open(fileName);
+	}
+	catch(const FileFormatException &e)
+	{
+		refused = true;
+	}
+	checkPassFail(refused, true)
+	File::remove(fileName);
+}
+
+void allocatePageTest()
+{
+	// New and reused pages are linked in at the tail of the used list, also after the tail is deleted
+	std::cout << "--------------------" << std::endl;
+	std::cout << "allocatePageTest" << std::endl;
+	const std::string fileName = "relA.alloc";
+	const int numPages = 6;
+	try
+	{
+		File::remove(fileName);
+	}
+	catch(const FileNotFoundException &)
+	{
+	}
+	{
+		PageFile file = PageFile::create(fileName);
+		std::vector<PageId> pageNos;
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+			pageNos.push_back(pageNo);
+		}
+		file.deletePage(pageNos[2]);
+		file.deletePage(pageNos[numPages - 1]);
+
+		PageId reusedNo, appendedNo;
+		file.allocatePage(reusedNo);
+		file.allocatePage(appendedNo);
+		checkPassFail(reusedNo, pageNos[numPages - 1])
+		checkPassFail(appendedNo, pageNos[2])
+
+		std::vector<PageId> listed;
+		for (FileIterator iter = file.begin(); iter != file.end(); iter++)
+		{
+			listed.push_back((*iter).page_number());
+		}
+		std::vector<PageId> expected;
+		expected.push_back(pageNos[0]);
+		expected.push_back(pageNos[1]);
+		expected.push_back(pageNos[3]);
+		expected.push_back(pageNos[4]);
+		expected.push_back(reusedNo);
+		expected.push_back(appendedNo);
+		bool inOrder = listed == expected;
+		checkPassFail(inOrder, true)
+
+		// the previous page numbers lead back from the tail to the head, also after the head is deleted
+		file.deletePage(pageNos[0]);
+		int walked = 0;
+		for (PageId pageNo = appendedNo; pageNo != Page::INVALID_NUMBER; pageNo = file.readPage(pageNo).prev_page_number())
+		{
+			walked++;
+		}
+		checkPassFail(walked, numPages - 1)
+	}
+	File::remove(fileName);
+}
+
+/**
+ * Page numbers of the used pages of the file, walked without reading the pages.
+ */
+std::vector<PageId> listPageNumbers(PageFile &file)
+{
+	std::vector<PageId> pageNos;
+	for (FileIterator iter = file.begin(); iter != file.end(); iter++)
+	{
+		pageNos.push_back(iter.page_number());
+	}
+	return pageNos;
+}
+
+void pageDirectoryTest()
+{
+	// The page list is walked from the page directory, which must follow allocations and deletions
+	// and be rebuilt from disk when the file is opened again
+	std::cout << "--------------------" << std::endl;
+	std::cout << "pageDirectoryTest" << std::endl;
+	const std::string fileName = "relA.directory";
+	const int numPages = 6;
+	try
+	{
+		File::remove(fileName);
+	}
+	catch(const FileNotFoundException &)
+	{
+	}
+	std::vector<PageId> expected;
+	{
+		PageFile file = PageFile::create(fileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+			expected.push_back(pageNo);
+		}
+		file.deletePage(expected[1]);
+		file.deletePage(expected[3]);
+		expected.erase(expected.begin() + 3);
+		expected.erase(expected.begin() + 1);
+		bool same = listPageNumbers(file) == expected;
+		checkPassFail(same, true)
+	}
+	{
+		PageFile file = PageFile::open(fileName);
+		bool same = listPageNumbers(file) == expected;
+		checkPassFail(same, true)
+
+		file.deletePage(expected[1]);
+		expected.erase(expected.begin() + 1);
+		same = listPageNumbers(file) == expected;
+		checkPassFail(same, true)
+	}
+	File::remove(fileName);
+}
+
+void recordViewTest()
+{
+	// Record views handed out by a FileScan must hold the same bytes as the copied records
+	std::cout << "--------------------" << std::endl;
+	std::cout << "recordViewTest" << std::endl;
+	createRelationForward();
+	int count = 0;
+	int same = 0;
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while (1)
+			{
+				fscan.scanNext(scanRid);
+				RecordView view = fscan.getRecordView();
+				int key;
+				memcpy(&key, view.data + offsetof(RECORD, i), sizeof(int));
+				same += view.str() == fscan.getRecord() && key == count;
+				count++;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	}
+	checkPassFail(count, relationSize)
+	checkPassFail(same, relationSize)
+	deleteRelation();
+}
+
+void scanBatchTest()
+{
+	// Batches must return every record once, in scan order, and report the end of the file by
+	// returning 0; small batches must continue where the last one stopped
+	std::cout << "--------------------" << std::endl;
+	std::cout << "scanBatchTest" << std::endl;
+	createRelationForward();
+	const int batchSizes[] = {SCAN_BATCH_SIZE, 7};
+	for (int b = 0; b < 2; b++)
+	{
+		int count = 0;
+		int inOrder = 0;
+		{
+			FileScan fscan(relationName, bufMgr);
+			std::vector<RecordId> rids(batchSizes[b]);
+			std::vector<RecordView> views(batchSizes[b]);
+			int n;
+			while ((n = fscan.scanNextBatch(&rids[0], &views[0], batchSizes[b])) > 0)
+			{
+				for (int i = 0; i < n; i++)
+				{
+					int key;
+					memcpy(&key, views[i].data + offsetof(RECORD, i), sizeof(int));
+					inOrder += key == count;
+					count++;
+				}
+			}
+			n = fscan.scanNextBatch(&rids[0], &views[0], batchSizes[b]);
+			checkPassFail(n, 0)
+
+			// an empty batch could not be told from the end of the file
+			bool rejected = false;
+			try
+			{
+				fscan.scanNextBatch(&rids[0], &views[0], 0);
+			}
+			catch(const BadScanParamException &e)
+			{
+				rejected = true;
+			}
+			checkPassFail(rejected, true)
+		}
+		checkPassFail(count, relationSize)
+		checkPassFail(inOrder, relationSize)
+	}
+	deleteRelation();
+}
+
+/**
+ * Number of records a FileScan returns, both through scanNext and scanNextBatch
+ */
+int countScan(FileScan &fscan)
+{
+	int count = 0;
+	try
+	{
+		RecordId scanRid;
+		while (1)
+		{
+			fscan.scanNext(scanRid);
+			count++;
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	return count;
+}
+
+void scanFilterTest()
+{
+	// Filters pushed into a FileScan on each attribute type must return exactly the matching records
+	std::cout << "--------------------" << std::endl;
+	std::cout << "scanFilterTest" << std::endl;
+	createRelationForward();
+	{
+		FileScan fscan(relationName, bufMgr);
+		int low = 100, high = 200;
+		fscan.addFilter(offsetof(RECORD, i), INTEGER, GTE, &low);
+		fscan.addFilter(offsetof(RECORD, i), INTEGER, LT, &high);
+		checkPassFail(countScan(fscan), 100)
+	}
+	{
+		FileScan fscan(relationName, bufMgr);
+		double low = relationSize - 11;
+		fscan.addFilter(offsetof(RECORD, d), DOUBLE, GT, &low);
+		checkPassFail(countScan(fscan), 10)
+	}
+	{
+		FileScan fscan(relationName, bufMgr);
+		fscan.addFilter(offsetof(RECORD, s), STRING, GTE, "00500");
+		fscan.addFilter(offsetof(RECORD, s), STRING, LTE, "00599 string record");
+		RecordId rids[SCAN_BATCH_SIZE];
+		int count = 0;
+		int n;
+		while ((n = fscan.scanNextBatch(rids, NULL, SCAN_BATCH_SIZE)) > 0)
+		{
+			count += n;
+		}
+		checkPassFail(count, 100)
+	}
+	{
+		FileScan fscan(relationName, bufMgr);
+		int low = 0;
+		fscan.addFilter(offsetof(RECORD, i), INTEGER, LT, &low);
+		checkPassFail(countScan(fscan), 0)
+	}
+	{
+		FileScan fscan(relationName, bufMgr);
+		int low = 0;
+		fscan.addFilter(offsetof(RECORD, i), INTEGER, LT, &low);
+		fscan.clearFilters();
+		checkPassFail(countScan(fscan), relationSize)
+	}
+	deleteRelation();
+}
+
+void parallelScanTest()
+{
+	// A parallel scan must find the same records as a FileScan, and merge them in the same order
+	std::cout << "--------------------" << std::endl;
+	std::cout << "parallelScanTest" << std::endl;
+	createRelationForward();
+	std::vector<RecordId> expected;
+	{
+		FileScan fscan(relationName, bufMgr);
+		RecordId rids[SCAN_BATCH_SIZE];
+		int n;
+		while ((n = fscan.scanNextBatch(rids, NULL, SCAN_BATCH_SIZE)) > 0)
+		{
+			expected.insert(expected.end(), rids, rids + n);
+		}
+	}
+	{
+		ParallelFileScan pscan(relationName, bufMgr, 4);
+		bool same = pscan.collectRecordIds() == expected;
+		checkPassFail(same, true)
+
+		int low = 1000;
+		pscan.addFilter(offsetof(RECORD, i), INTEGER, GTE, &low);
+		std::vector<long> sums(pscan.getNumWorkers(), 0);
+		pscan.scan([&sums](int worker, const RecordId &rid, const RecordView &record) {
+			int key;
+			memcpy(&key, record.data + offsetof(RECORD, i), sizeof(int));
+			sums[worker] += key;
+		});
+		long sum = 0;
+		for (std::size_t i = 0; i < sums.size(); i++)
+		{
+			sum += sums[i];
+		}
+		checkPassFail(sum, (long)relationSize * (relationSize - 1) / 2 - 1000L * 999 / 2)
+	}
+	deleteRelation();
+}
+
+void nodeSearchTest()
+{
+	// The node searches must agree with std::lower_bound/upper_bound for every array size around
+	// the search window and the vector width, with duplicate keys, on whichever code path the CPU takes
+	std::cout << "--------------------" << std::endl;
+	std::cout << "nodeSearchTest" << " (avx2: " << nodeSearchUsesAvx2() << ")" << std::endl;
+	int wrong = 0;
+	for (int size = 0; size <= 100; size++)
+	{
+		std::vector<int> ints;
+		std::vector<double> doubles;
+		std::vector<char> strings;
+		for (int i = 0; i < size; i++)
+		{
+			ints.push_back(2 * (i / 2));
+			doubles.push_back(0.5 * (i / 2));
+			char key[16] = {0};
+			snprintf(key, sizeof(key), "%05d", 2 * (i / 2));
+			strings.insert(strings.end(), key, key + STRINGSIZE);
+		}
+		for (int v = -1; v <= size + 1; v++)
+		{
+			wrong += keyLowerBound(ints.data(), size, v) != std::lower_bound(ints.begin(), ints.end(), v) - ints.begin();
+			wrong += keyUpperBound(ints.data(), size, v) != std::upper_bound(ints.begin(), ints.end(), v) - ints.begin();
+			double d = 0.25 * v;
+			wrong += keyLowerBound(doubles.data(), size, d) != std::lower_bound(doubles.begin(), doubles.end(), d) - doubles.begin();
+			wrong += keyUpperBound(doubles.data(), size, d) != std::upper_bound(doubles.begin(), doubles.end(), d) - doubles.begin();
+
+			char key[16] = {0};
+			snprintf(key, sizeof(key), "%05d", v < 0 ? 0 : v);
+			std::string s(key, STRINGSIZE);
+			int lower = 0, upper = 0;
+			for (int i = 0; i < size; i++)
+			{
+				std::string k(&strings[i * STRINGSIZE], STRINGSIZE);
+				lower += k < s;
+				upper += k <= s;
+			}
+			wrong += keyLowerBound(strings.data(), STRINGSIZE, size, s) != lower;
+			wrong += keyUpperBound(strings.data(), STRINGSIZE, size, s) != upper;
+		}
+	}
+	checkPassFail(wrong, 0)
+}
+
+/**
+ * Key of the relation record an index entry points to
+ */
+int recordKey(const RecordId &rid)
+{
+	Page *page;
+	bufMgr->readPage(file1, rid.page_number, page);
+	int key;
+	memcpy(&key, page->getRecordView(rid).data + offsetof(RECORD, i), sizeof(int));
+	bufMgr->unPinPage(file1, rid.page_number, false);
+	return key;
+}
+
+void indexCursorTest()
+{
+	// Cursors on one index scan independently of each other and of startScan/scanNext
+	std::cout << "--------------------" << std::endl;
+	std::cout << "indexCursorTest" << std::endl;
+	createRelationForward();
+	{
+		BTreeBuildOptions options;
+		options.fillFactor = 0.1;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+
+		// two overlapping ranges, stepped alternately
+		int low1 = 1000, high1 = 3000, low2 = 2000, high2 = 4000;
+		IndexCursor first(index, &low1, GTE, &high1, LT);
+		IndexCursor second(index, &low2, GTE, &high2, LTE);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		int expected1 = low1, expected2 = low2, wrong = 0;
+		bool firstDone = false, secondDone = false;
+		while (!firstDone || !secondDone)
+		{
+			RecordId rid;
+			if (!firstDone)
+			{
+				try
+				{
+					first.scanNext(rid);
+					wrong += recordKey(rid) != expected1++;
+				}
+				catch(const IndexScanCompletedException &e)
+				{
+					firstDone = true;
+				}
+			}
+			if (!secondDone)
+			{
+				try
+				{
+					second.scanNext(rid);
+					wrong += recordKey(rid) != expected2++;
+				}
+				catch(const IndexScanCompletedException &e)
+				{
+					secondDone = true;
+				}
+			}
+		}
+		checkPassFail(wrong, 0)
+		checkPassFail(expected1, high1)
+		checkPassFail(expected2, high2 + 1)
+
+		// an empty range throws without leaving a pin behind, an abandoned cursor unpins its leaf
+		int low3 = relationSize, high3 = relationSize + 100;
+		bool noKey = false;
+		try
+		{
+			IndexCursor empty(index, &low3, GTE, &high3, LT);
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+			noKey = true;
+		}
+		checkPassFail(noKey, true)
+		{
+			IndexCursor abandoned(index, &low1, GT, &high1, LT);
+			RecordId rid;
+			abandoned.scanNext(rid);
+		}
+
+		// cursors on several threads at once
+		const int threads = 4;
+		std::vector<int> counts(threads, 0);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++)
+		{
+			workers.push_back(std::thread([&index, &counts, t]() {
+				int low = t * 1000, high = low + 1500;
+				IndexCursor cursor(index, &low, GTE, &high, LT);
+				try
+				{
+					RecordId rid;
+					while (1)
+					{
+						cursor.scanNext(rid);
+						counts[t]++;
+					}
+				}
+				catch(const IndexScanCompletedException &e)
+				{
+				}
+			}));
+		}
+		for (int t = 0; t < threads; t++)
+		{
+			workers[t].join();
+		}
+		int total = 0;
+		for (int t = 0; t < threads; t++)
+		{
+			total += counts[t];
+		}
+		checkPassFail(total, threads * 1500)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void indexScanBatchTest()
+{
+	// Batches must return what scanNext returns, with the keys, and signal the end of the range with 0
+	std::cout << "--------------------" << std::endl;
+	std::cout << "indexScanBatchTest" << std::endl;
+	createRelationForward();
+	{
+		BTreeBuildOptions options;
+		options.fillFactor = 0.1;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+
+		int low = 100, high = 4100;
+		std::vector<RecordId> expected;
+		{
+			IndexCursor cursor(index, &low, GT, &high, LTE);
+			try
+			{
+				RecordId rid;
+				while (1)
+				{
+					cursor.scanNext(rid);
+					expected.push_back(rid);
+				}
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+		}
+		checkPassFail((int)expected.size(), high - low)
+
+		// a batch size that does not divide the leaves
+		std::vector<RecordId> rids;
+		RecordId batch[37];
+		int keys[37];
+		int wrongKeys = 0;
+		int n;
+		index.startScan(&low, GT, &high, LTE);
+		while ((n = index.scanNextBatch(batch, keys, 37)) > 0)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				wrongKeys += keys[i] != low + 1 + (int)rids.size();
+				rids.push_back(batch[i]);
+			}
+		}
+		checkPassFail(index.scanNextBatch(batch, NULL, 37), 0)
+		bool completed = false;
+		try
+		{
+			RecordId rid;
+			index.scanNext(rid);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			completed = true;
+		}
+		index.endScan();
+		bool same = rids == expected;
+		checkPassFail(same, true)
+		checkPassFail(wrongKeys, 0)
+		checkPassFail(completed, true)
+
+		// a range that ends inside the first leaf and one past the last key
+		int low2 = 10, high2 = 12, low3 = relationSize - 5, high3 = relationSize + 5;
+		IndexCursor shortRange(index, &low2, GTE, &high2, LT);
+		checkPassFail(shortRange.scanNextBatch(batch, NULL, 37), 2)
+		IndexCursor tail(index, &low3, GTE, &high3, LT);
+		checkPassFail(tail.scanNextBatch(batch, NULL, 37), 5)
+		checkPassFail(tail.scanNextBatch(batch, NULL, 37), 0)
+
+		// an empty batch could not be told from the end of the range
+		bool rejected = false;
+		try
+		{
+			shortRange.scanNextBatch(batch, NULL, 0);
+		}
+		catch(const BadScanParamException &e)
+		{
+			rejected = true;
+		}
+		checkPassFail(rejected, true)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void indexOnlyScanTest()
+{
+	// Keys and aggregates come from the leaves and must match the records they point to
+	std::cout << "--------------------" << std::endl;
+	std::cout << "indexOnlyScanTest" << std::endl;
+	createRelationRandom();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		int low = 250, high = 750, key;
+		int wrong = 0, count = 0;
+		IndexCursor cursor(index, &low, GTE, &high, LT);
+		try
+		{
+			RecordId rid;
+			while (1)
+			{
+				cursor.scanNext(rid, &key);
+				wrong += key != recordKey(rid) || key != low + count;
+				count++;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+		checkPassFail(count, high - low)
+		checkPassFail(wrong, 0)
+
+		IndexAggregate agg;
+		int minKey = 0, maxKey = 0;
+		index.aggregate(&low, GT, &high, LTE, agg, &minKey, &maxKey);
+		checkPassFail(agg.count, (long)(high - low))
+		checkPassFail((long)agg.sum, (long)(low + 1 + high) * (high - low) / 2)
+		checkPassFail(minKey, low + 1)
+		checkPassFail(maxKey, high)
+
+		// an empty range leaves the keys alone
+		int low2 = relationSize + 10, high2 = relationSize + 20;
+		index.aggregate(&low2, GTE, &high2, LTE, agg, &minKey, &maxKey);
+		checkPassFail(agg.count, 0L)
+		checkPassFail(minKey, low + 1)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void coveringIndexTest()
+{
+	// INCLUDE columns come back from the leaves, through the external sort, a reopen and an insert
+	std::cout << "--------------------" << std::endl;
+	std::cout << "coveringIndexTest" << std::endl;
+	createRelationRandom();
+	const int prefix = 5;
+	{
+		BTreeBuildOptions options;
+		options.sortMemoryBudget = 16 * 1024;
+		IncludeColumn d = {(int)offsetof(RECORD, d), sizeof(double)};
+		IncludeColumn s = {(int)offsetof(RECORD, s), prefix};
+		options.includeColumns.push_back(d);
+		options.includeColumns.push_back(s);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(index.getIncludeWidth(), (int)sizeof(double) + prefix)
+
+		int low = 1000, high = 3000;
+		int width = index.getIncludeWidth();
+		RecordId rids[50];
+		int keys[50];
+		std::vector<char> includes(50 * width);
+		int wrong = 0, count = 0, n;
+		IndexCursor cursor(index, &low, GTE, &high, LT);
+		while ((n = cursor.scanNextBatch(rids, keys, &includes[0], 50)) > 0)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				double value;
+				char expected[8];
+				memcpy(&value, &includes[i * width], sizeof(double));
+				sprintf(expected, "%05d", keys[i]);
+				wrong += value != (double)keys[i] || memcmp(&includes[i * width + sizeof(double)], expected, prefix) != 0
+					|| recordKey(rids[i]) != keys[i];
+			}
+			count += n;
+		}
+		checkPassFail(count, high - low)
+		checkPassFail(wrong, 0)
+
+		// entries of a covering index need their record
+		bool needsRecord = false;
+		try
+		{
+			int key = relationSize;
+			index.insertEntry(&key, rids[0]);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			needsRecord = true;
+		}
+		checkPassFail(needsRecord, true)
+
+		RECORD added;
+		memset(&added, 0, sizeof(RECORD));
+		added.i = relationSize;
+		added.d = 0.5;
+		strcpy(added.s, "added");
+		index.insertEntry(&added.i, rids[0], std::string(reinterpret_cast<char*>(&added), sizeof(RECORD)));
+		IndexCursor last(index, &added.i, GTE, &added.i, LTE);
+		int key;
+		checkPassFail(last.scanNextBatch(rids, &key, &includes[0], 50), 1)
+		double value;
+		memcpy(&value, &includes[0], sizeof(double));
+		bool same = value == 0.5 && memcmp(&includes[sizeof(double)], "added", prefix) == 0;
+		checkPassFail(same, true)
+	}
+	{
+		// the columns are read back from the meta page
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getIncludeWidth(), (int)sizeof(double) + prefix)
+		int low = 42;
+		IndexCursor cursor(index, &low, GTE, &low, LTE);
+		RecordId rid;
+		int key;
+		std::vector<char> includes(index.getIncludeWidth());
+		checkPassFail(cursor.scanNextBatch(&rid, &key, &includes[0], 1), 1)
+		double value;
+		memcpy(&value, &includes[0], sizeof(double));
+		bool same = value == 42.0 && memcmp(&includes[sizeof(double)], "00042", prefix) == 0;
+		checkPassFail(same, true)
+	}
+	{
+		// asking for other columns than the index was built with is refused, the same ones are fine
+		BTreeBuildOptions options;
+		IncludeColumn d = {(int)offsetof(RECORD, d), sizeof(double)};
+		options.includeColumns.push_back(d);
+		bool refused = false;
+		try
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+
+		IncludeColumn s = {(int)offsetof(RECORD, s), prefix};
+		options.includeColumns.push_back(s);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(index.getIncludeWidth(), (int)sizeof(double) + prefix)
+	}
+	{
+		// a column count that cannot be right is refused instead of read past the meta page
+		{
+			BlobFile indexFile = BlobFile::open(intIndexName);
+			Page metaPage = indexFile.readPage(1);
+			reinterpret_cast<IndexMetaInfo*>(&metaPage)->includeCount = MAX_INCLUDE_COLUMNS + 1;
+			indexFile.writePage(1, metaPage);
+		}
+		bool refused = false;
+		try
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+	// columns that do not fit are refused before any file is created
+	bool refused = false;
+	try
+	{
+		BTreeBuildOptions options;
+		IncludeColumn wide = {0, Page::SIZE};
+		options.includeColumns.push_back(wide);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		refused = true;
+	}
+	checkPassFail(refused, true)
+	deleteRelation();
+}
+
+void lookupTest()
+{
+	// Point lookups find every entry with the key, including runs of duplicates over several
+	// leaves, and leave a running scan alone
+	std::cout << "--------------------" << std::endl;
+	std::cout << "lookupTest" << std::endl;
+	createRelationForward();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		std::vector<RecordId> rids;
+		int wrong = 0;
+		for (int key = 0; key < relationSize; key++)
+		{
+			wrong += index.lookup(&key, rids) != 1 || recordKey(rids[0]) != key;
+		}
+		checkPassFail(wrong, 0)
+
+		int missing[] = {-1, relationSize, relationSize + 7};
+		int found = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			found += index.lookup(&missing[i], rids) + index.contains(&missing[i]);
+		}
+		checkPassFail(found, 0)
+		checkPassFail((int)rids.size(), 0)
+		int present = relationSize / 2;
+		checkPassFail(index.contains(&present), true)
+
+		// enough copies of the largest key to split its leaf
+		int last = relationSize - 1;
+		index.lookup(&last, rids);
+		RecordId lastRid = rids[0];
+		const int copies = 700;
+		for (int i = 0; i < copies; i++)
+		{
+			index.insertEntry(&last, lastRid);
+		}
+		checkPassFail(index.lookup(&last, rids), copies + 1)
+		int wrongRids = 0;
+		for (std::size_t i = 0; i < rids.size(); i++)
+		{
+			wrongRids += !(rids[i] == lastRid);
+		}
+		checkPassFail(wrongRids, 0)
+		checkPassFail(index.contains(&last), true)
+
+		// lookups do not touch the scan state
+		int low = 100, high = 200;
+		index.startScan(&low, GTE, &high, LT);
+		RecordId rid;
+		index.scanNext(rid);
+		index.lookup(&present, rids);
+		index.scanNext(rid);
+		index.endScan();
+		checkPassFail(recordKey(rid), low + 1)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+/**
+ * Size in bytes of a file on disk.
+ */
+long fileSize(const std::string &name)
+{
+	std::ifstream in(name.c_str(), std::ifstream::binary | std::ifstream::ate);
+	return in.tellg();
+}
+
+void appendInsertTest()
+{
+	// Ascending inserts fill the leaves like the bulk loader does, through several levels of
+	// non-leaf splits; wide INCLUDE columns make the leaves small enough to get there quickly
+	std::cout << "--------------------" << std::endl;
+	std::cout << "appendInsertTest" << std::endl;
+	createRelationForward();
+	const int appended = 2 * relationSize;
+	BTreeBuildOptions options;
+	IncludeColumn wide = {0, 1000};
+	options.includeColumns.push_back(wide);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	}
+	long bulkLoaded = fileSize(intIndexName);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		RECORD appendedRecord;
+		memset(&appendedRecord, 0, sizeof(RECORD));
+		RecordId rid = {1, 1};
+		for (int i = 0; i < appended; i++)
+		{
+			appendedRecord.i = relationSize + i;
+			index.insertEntry(&appendedRecord.i, rid, std::string(reinterpret_cast<char*>(&appendedRecord), sizeof(RECORD)));
+		}
+
+		// every key once, in order, from a scan and from lookups
+		int low = 0, high = relationSize + appended;
+		IndexCursor cursor(index, &low, GTE, &high, LT);
+		RecordId rids[100];
+		int keys[100];
+		int n, count = 0, wrong = 0;
+		while ((n = cursor.scanNextBatch(rids, keys, 100)) > 0)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				wrong += keys[i] != count++;
+			}
+		}
+		checkPassFail(count, relationSize + appended)
+		checkPassFail(wrong, 0)
+		std::vector<RecordId> found;
+		int missing = 0;
+		for (int key = 0; key < relationSize + appended; key += 7)
+		{
+			missing += index.lookup(&key, found) != 1;
+		}
+		checkPassFail(missing, 0)
+	}
+	// three times the entries of the bulk-loaded index take about three times its pages
+	bool dense = fileSize(intIndexName) < bulkLoaded * 3 + bulkLoaded / 10;
+	checkPassFail(dense, true)
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void descendingInsertTest()
+{
+	// Keys inserted in descending order land in the middle and at the start of full nodes, so
+	// leaves and non-leaf nodes are split anywhere; scans and lookups must still see sorted leaves
+	std::cout << "--------------------" << std::endl;
+	std::cout << "descendingInsertTest" << std::endl;
+	createRelationForward();
+	const int inserted = 2 * relationSize;
+	BTreeBuildOptions options;
+	IncludeColumn wide = {0, 1000};
+	options.includeColumns.push_back(wide);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		RECORD insertedRecord;
+		memset(&insertedRecord, 0, sizeof(RECORD));
+		RecordId rid = {1, 1};
+		// new keys before every built one, then a second copy of every third built key
+		for (int i = 1; i <= inserted; i++)
+		{
+			insertedRecord.i = -i;
+			index.insertEntry(&insertedRecord.i, rid, std::string(reinterpret_cast<char*>(&insertedRecord), sizeof(RECORD)));
+		}
+		for (int key = relationSize - 1; key >= 0; key -= 3)
+		{
+			insertedRecord.i = key;
+			index.insertEntry(&insertedRecord.i, rid, std::string(reinterpret_cast<char*>(&insertedRecord), sizeof(RECORD)));
+		}
+
+		int low = -inserted, high = relationSize;
+		IndexCursor cursor(index, &low, GTE, &high, LT);
+		RecordId rids[100];
+		int keys[100];
+		int n, count = 0, unsorted = 0, previous = low;
+		while ((n = cursor.scanNextBatch(rids, keys, 100)) > 0)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				unsorted += keys[i] < previous;
+				previous = keys[i];
+			}
+			count += n;
+		}
+		checkPassFail(count, inserted + relationSize + (relationSize + 2) / 3)
+		checkPassFail(unsorted, 0)
+
+		std::vector<RecordId> found;
+		int wrong = 0;
+		for (int key = -inserted; key < relationSize; key += 7)
+		{
+			const int copies = key < 0 ? 1 : ((relationSize - 1 - key) % 3 == 0 ? 2 : 1);
+			wrong += index.lookup(&key, found) != copies;
+		}
+		checkPassFail(wrong, 0)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void duplicateKeyScanTest()
+{
+	// Runs of duplicates longer than a leaf: a scan starting at a key must find the copies left
+	// of the separator equal to it as well
+	std::cout << "--------------------" << std::endl;
+	std::cout << "duplicateKeyScanTest" << std::endl;
+	const int copies = 500;
+	const int numKeys = relationSize / copies;
+	createRelationDuplicateKeys(copies);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		int wrongCount = 0, wrongKey = 0;
+		for (int key = 0; key < numKeys; key++)
+		{
+			int count = 0;
+			index.startScan(&key, GTE, &key, LTE);
+			try
+			{
+				RecordId rid;
+				while (1)
+				{
+					index.scanNext(rid);
+					wrongKey += recordKey(rid) != key;
+					count++;
+				}
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+			index.endScan();
+			wrongCount += count != copies;
+		}
+		checkPassFail(wrongCount, 0)
+		checkPassFail(wrongKey, 0)
+
+		// and so do cursors fetching batches
+		int wrongBatch = 0;
+		for (int key = 0; key < numKeys; key++)
+		{
+			IndexCursor cursor(index, &key, GTE, &key, LTE);
+			RecordId batch[128];
+			int n, count = 0;
+			while ((n = cursor.scanNextBatch(batch, NULL, 128)) > 0)
+			{
+				count += n;
+			}
+			wrongBatch += count != copies;
+		}
+		checkPassFail(wrongBatch, 0)
+
+		// aggregates take the same descent
+		int wrongAgg = 0;
+		for (int key = 0; key < numKeys; key++)
+		{
+			IndexAggregate agg;
+			int minKey = -1, maxKey = -1;
+			index.aggregate(&key, GTE, &key, LTE, agg, &minKey, &maxKey);
+			wrongAgg += agg.count != copies || (long)agg.sum != (long)key * copies || minKey != key || maxKey != key;
+		}
+		checkPassFail(wrongAgg, 0)
+
+		// a GT scan skips every copy of its low key
+		int low = 3, high = 5;
+		index.startScan(&low, GT, &high, LTE);
+		RecordId rid;
+		index.scanNext(rid);
+		index.endScan();
+		checkPassFail(recordKey(rid), low + 1)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
 // -----------------------------------------------------------------------------
 // doubleTests
 // -----------------------------------------------------------------------------
@@ -0,0 +1,242 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "node_search.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NODE_SEARCH_X86 1
+#endif
+
+namespace badgerdb
+{
+
+namespace {
+
+/**
+ * Number of keys left when the binary search stops and the keys are counted instead
+ */
+const int SEARCH_WINDOW = 32;
+
+/**
+ * Narrow [0, size] down to a window of at most SEARCH_WINDOW keys that holds the answer: every
+ * key before `lo` satisfies the comparison and every key after lo + n does not. The comparison
+ * is key < value for a lower bound and key <= value for an upper bound; either way the keys that
+ * satisfy it are a prefix of the sorted array.
+ */
+template <class T, class Satisfies>
+inline void narrow(const T *keys, int size, Satisfies satisfies, int &lo, int &n)
+{
+	lo = 0;
+	n = size;
+	while (n > SEARCH_WINDOW)
+	{
+		int half = n / 2;
+		// a conditional move rather than a branch
+		lo = satisfies(keys[lo + half - 1]) ? lo + half : lo;
+		n -= half;
+	}
+}
+
+template <class T, class Satisfies>
+inline int countScalar(const T *keys, int n, Satisfies satisfies)
+{
+	int count = 0;
+	for (int i = 0; i < n; i++)
+	{
+		count += satisfies(keys[i]);
+	}
+	return count;
+}
+
+template <class T>
+struct Less
+{
+	T value;
+	bool operator()(const T &key) const { return key < value; }
+};
+
+template <class T>
+struct LessEqual
+{
+	T value;
+	bool operator()(const T &key) const { return key <= value; }
+};
+
+#ifdef NODE_SEARCH_X86
+
+// compiled for AVX2 on their own, so the rest of the file keeps the default instruction set
+
+__attribute__((target("avx2,popcnt")))
+int countIntAvx2(const int *keys, int n, int value, bool orEqual)
+{
+	const __m256i v = _mm256_set1_epi32(value);
+	int count = 0;
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+		// key < value is value > key; key <= value is !(key > value)
+		__m256i m = orEqual ? _mm256_cmpgt_epi32(k, v) : _mm256_cmpgt_epi32(v, k);
+		int bits = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+		count += orEqual ? 8 - bits : bits;
+	}
+	for (; i < n; i++)
+	{
+		count += orEqual ? keys[i] <= value : keys[i] < value;
+	}
+	return count;
+}
+
+__attribute__((target("avx2,popcnt")))
+int countDoubleAvx2(const double *keys, int n, double value, bool orEqual)
+{
+	const __m256d v = _mm256_set1_pd(value);
+	int count = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d k = _mm256_loadu_pd(keys + i);
+		__m256d m = orEqual ? _mm256_cmp_pd(k, v, _CMP_LE_OQ) : _mm256_cmp_pd(k, v, _CMP_LT_OQ);
+		count += __builtin_popcount(_mm256_movemask_pd(m));
+	}
+	for (; i < n; i++)
+	{
+		count += orEqual ? keys[i] <= value : keys[i] < value;
+	}
+	return count;
+}
+
+bool detectAvx2()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}
+
+#endif
+
+bool haveAvx2()
+{
+#ifdef NODE_SEARCH_X86
+	static const bool avx2 = detectAvx2();
+	return avx2;
+#else
+	return false;
+#endif
+}
+
+int searchInt(const int *keys, int size, int value, bool orEqual)
+{
+	int lo, n;
+	if (orEqual)
+	{
+		LessEqual<int> satisfies = {value};
+		narrow(keys, size, satisfies, lo, n);
+	}
+	else
+	{
+		Less<int> satisfies = {value};
+		narrow(keys, size, satisfies, lo, n);
+	}
+#ifdef NODE_SEARCH_X86
+	if (haveAvx2())
+	{
+		return lo + countIntAvx2(keys + lo, n, value, orEqual);
+	}
+#endif
+	if (orEqual)
+	{
+		LessEqual<int> satisfies = {value};
+		return lo + countScalar(keys + lo, n, satisfies);
+	}
+	Less<int> satisfies = {value};
+	return lo + countScalar(keys + lo, n, satisfies);
+}
+
+int searchDouble(const double *keys, int size, double value, bool orEqual)
+{
+	int lo, n;
+	if (orEqual)
+	{
+		LessEqual<double> satisfies = {value};
+		narrow(keys, size, satisfies, lo, n);
+	}
+	else
+	{
+		Less<double> satisfies = {value};
+		narrow(keys, size, satisfies, lo, n);
+	}
+#ifdef NODE_SEARCH_X86
+	if (haveAvx2())
+	{
+		return lo + countDoubleAvx2(keys + lo, n, value, orEqual);
+	}
+#endif
+	if (orEqual)
+	{
+		LessEqual<double> satisfies = {value};
+		return lo + countScalar(keys + lo, n, satisfies);
+	}
+	Less<double> satisfies = {value};
+	return lo + countScalar(keys + lo, n, satisfies);
+}
+
+int searchString(const char *keys, int keyLength, int size, const std::string &value, bool orEqual)
+{
+	// plain binary search: each comparison is a string comparison anyway
+	int lo = 0;
+	int hi = size;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		std::string key(keys + (std::size_t)mid * keyLength, keyLength);
+		if (orEqual ? key <= value : key < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+}
+
+int keyLowerBound(const int *keys, int size, int key)
+{
+	return searchInt(keys, size, key, false);
+}
+
+int keyUpperBound(const int *keys, int size, int key)
+{
+	return searchInt(keys, size, key, true);
+}
+
+int keyLowerBound(const double *keys, int size, double key)
+{
+	return searchDouble(keys, size, key, false);
+}
+
+int keyUpperBound(const double *keys, int size, double key)
+{
+	return searchDouble(keys, size, key, true);
+}
+
+int keyLowerBound(const char *keys, int keyLength, int size, const std::string &key)
+{
+	return searchString(keys, keyLength, size, key, false);
+}
+
+int keyUpperBound(const char *keys, int keyLength, int size, const std::string &key)
+{
+	return searchString(keys, keyLength, size, key, true);
+}
+
+bool nodeSearchUsesAvx2()
+{
+	return haveAvx2();
+}
+
+}
@@ -0,0 +1,41 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Searches of the sorted key array of a B+ tree node.
+ *
+ * keyLowerBound returns the number of keys less than the key, i.e. the position of the first key
+ * not less than it; keyUpperBound returns the number of keys less than or equal to the key.
+ * Both narrow the range down with a branch-free binary search and count the keys of the last few
+ * elements at once, with AVX2 when the CPU has it (checked once at run time) and a scalar loop
+ * otherwise.
+ */
+int keyLowerBound(const int *keys, int size, int key);
+int keyUpperBound(const int *keys, int size, int key);
+int keyLowerBound(const double *keys, int size, double key);
+int keyUpperBound(const double *keys, int size, double key);
+
+/**
+ * String keys are stored as fixed arrays of keyLength chars and compared as
+ * std::string(keys[i], keyLength), like the rest of the index does.
+ */
+int keyLowerBound(const char *keys, int keyLength, int size, const std::string &key);
+int keyUpperBound(const char *keys, int keyLength, int size, const std::string &key);
+
+/**
+ * True if the searches use the AVX2 code path on this CPU
+ */
+bool nodeSearchUsesAvx2();
+
+}
@@ -0,0 +1,269 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "replacement_policy.h"
+
+namespace badgerdb {
+
+ReplacementPolicy *ReplacementPolicy::create(const ReplacementPolicyType type, BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+{
+	switch (type)
+	{
+		case LRU_K_POLICY:
+			return new LRUKPolicy(descs, firstFrame, numFrames);
+		case TWO_Q_POLICY:
+			return new TwoQPolicy(descs, firstFrame, numFrames);
+		case CLOCK_POLICY:
+		default:
+			return new ClockPolicy(descs, firstFrame, numFrames);
+	}
+}
+
+//----------------------------------------
+// ClockPolicy
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+	: ReplacementPolicy(descs, firstFrame, numFrames), clockHand(firstFrame + numFrames - 1)
+{
+}
+
+void ClockPolicy::pageLoaded(const FrameId frame, const File *file, const PageId pageNo)
+{
+	// the reference bit is set when the frame is assigned to the page
+}
+
+void ClockPolicy::pageAccessed(const FrameId frame)
+{
+	// the buffer manager sets the reference bit on every hit
+}
+
+void ClockPolicy::frameFreed(const FrameId frame)
+{
+	// empty frames are found by the sweep
+}
+
+bool ClockPolicy::chooseVictim(FrameId &frame)
+{
+	std::uint32_t numScanned = 0;
+
+	while (numScanned < 2*numFrames)	//Need to scn twice
+	{
+		// advance the clock
+		advanceClock();
+		numScanned++;
+
+		// if invalid, use frame
+		if (!isValid(clockHand))
+		{
+			frame = clockHand;
+			return true;
+		}
+
+		// is valid, check referenced bit
+		if (!isReferenced(clockHand))
+		{
+			// check to see if someone has it pinned
+			if (!isPinned(clockHand))
+			{
+				// hasn't been referenced and is not pinned, use it
+				frame = clockHand;
+				return true;
+			}
+		}
+		else
+		{
+			// has been referenced, clear the bit
+			clearReferenced(clockHand);
+		}
+	}
+	return false;
+}
+
+//----------------------------------------
+// LRUKPolicy
+//----------------------------------------
+
+LRUKPolicy::LRUKPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+	: ReplacementPolicy(descs, firstFrame, numFrames), now(0), history(numFrames * K, 0)
+{
+	// hand out the first frame first
+	for (std::uint32_t i = numFrames; i > 0; i--)
+	{
+		freeFrames.push_back(firstFrame + i - 1);
+	}
+}
+
+void LRUKPolicy::pageLoaded(const FrameId frame, const File *file, const PageId pageNo)
+{
+	std::uint64_t *times = &history[(frame - firstFrame) * K];
+	std::fill(times, times + K, 0);
+	times[0] = ++now;
+}
+
+void LRUKPolicy::pageAccessed(const FrameId frame)
+{
+	std::uint64_t *times = &history[(frame - firstFrame) * K];
+	std::copy_backward(times, times + K - 1, times + K);
+	times[0] = ++now;
+}
+
+void LRUKPolicy::frameFreed(const FrameId frame)
+{
+	std::uint64_t *times = &history[(frame - firstFrame) * K];
+	std::fill(times, times + K, 0);
+	freeFrames.push_back(frame);
+}
+
+bool LRUKPolicy::chooseVictim(FrameId &frame)
+{
+	if (!freeFrames.empty())
+	{
+		frame = freeFrames.back();
+		freeFrames.pop_back();
+		return true;
+	}
+
+	// oldest K-th access wins (0 if the page has fewer than K accesses), then oldest last access
+	bool found = false;
+	std::uint64_t bestKth = 0, bestLast = 0;
+	for (FrameId i = firstFrame; i < firstFrame + numFrames; i++)
+	{
+		if (isPinned(i))
+			continue;
+		const std::uint64_t *times = &history[(i - firstFrame) * K];
+		if (!found || times[K - 1] < bestKth || (times[K - 1] == bestKth && times[0] < bestLast))
+		{
+			found = true;
+			frame = i;
+			bestKth = times[K - 1];
+			bestLast = times[0];
+		}
+	}
+	return found;
+}
+
+//----------------------------------------
+// TwoQPolicy
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+	: ReplacementPolicy(descs, firstFrame, numFrames),
+		kin(std::max(1u, numFrames / 4)), kout(std::max(1u, numFrames / 2)),
+		queueOf(numFrames, NONE), position(numFrames), pageOf(numFrames)
+{
+	for (std::uint32_t i = numFrames; i > 0; i--)
+	{
+		freeFrames.push_back(firstFrame + i - 1);
+	}
+}
+
+void TwoQPolicy::pageLoaded(const FrameId frame, const File *file, const PageId pageNo)
+{
+	const std::uint32_t i = frame - firstFrame;
+	pageOf[i] = PageKey(file, pageNo);
+
+	std::map<PageKey, std::list<PageKey>::iterator>::iterator ghost = a1outIndex.find(pageOf[i]);
+	if (ghost != a1outIndex.end())
+	{
+		// referenced again after it left A1in: the page is hot
+		a1out.erase(ghost->second);
+		a1outIndex.erase(ghost);
+		am.push_front(frame);
+		position[i] = am.begin();
+		queueOf[i] = AM;
+	}
+	else
+	{
+		a1in.push_front(frame);
+		position[i] = a1in.begin();
+		queueOf[i] = A1IN;
+	}
+}
+
+void TwoQPolicy::pageAccessed(const FrameId frame)
+{
+	const std::uint32_t i = frame - firstFrame;
+	// hits in A1in are correlated references and do not change the order
+	if (queueOf[i] == AM)
+	{
+		am.splice(am.begin(), am, position[i]);
+	}
+}
+
+void TwoQPolicy::frameFreed(const FrameId frame)
+{
+	const std::uint32_t i = frame - firstFrame;
+	if (queueOf[i] == A1IN)
+		a1in.erase(position[i]);
+	else if (queueOf[i] == AM)
+		am.erase(position[i]);
+	queueOf[i] = NONE;
+	freeFrames.push_back(frame);
+}
+
+bool TwoQPolicy::takeFromQueue(std::list<FrameId> &queue, FrameId &frame)
+{
+	for (std::list<FrameId>::iterator it = queue.end(); it != queue.begin(); )
+	{
+		--it;
+		if (!isPinned(*it))
+		{
+			frame = *it;
+			queue.erase(it);
+			queueOf[frame - firstFrame] = NONE;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TwoQPolicy::addGhost(const FrameId frame)
+{
+	const PageKey &key = pageOf[frame - firstFrame];
+	if (a1outIndex.find(key) != a1outIndex.end())
+		return;
+	a1out.push_front(key);
+	a1outIndex[key] = a1out.begin();
+	if (a1out.size() > kout)
+	{
+		a1outIndex.erase(a1out.back());
+		a1out.pop_back();
+	}
+}
+
+bool TwoQPolicy::chooseVictim(FrameId &frame)
+{
+	if (!freeFrames.empty())
+	{
+		frame = freeFrames.back();
+		freeFrames.pop_back();
+		return true;
+	}
+
+	if (a1in.size() > kin || am.empty())
+	{
+		if (takeFromQueue(a1in, frame))
+		{
+			addGhost(frame);
+			return true;
+		}
+		return takeFromQueue(am, frame);
+	}
+
+	if (takeFromQueue(am, frame))
+		return true;
+	if (takeFromQueue(a1in, frame))
+	{
+		addGhost(frame);
+		return true;
+	}
+	return false;
+}
+
+}
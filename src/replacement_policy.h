@@ -0,0 +1,211 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <map>
+#include <cstdint>
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Decides which frame of a buffer pool partition is reused next.
+*
+* The buffer manager creates one policy per partition and reports every page it places in a frame,
+* every buffer hit and every frame it empties. When it needs a frame it asks the policy for a victim:
+* an empty frame, or one holding an unpinned page which the buffer manager then evicts.
+* All calls are made with the partition lock held.
+*/
+class ReplacementPolicy {
+ public:
+	/**
+	 * Create the policy of the given type for a partition.
+	 *
+	 * @param type				Replacement policy to use
+	 * @param descs				Descriptor table of the whole buffer pool
+	 * @param firstFrame	First frame of the partition
+	 * @param numFrames		Number of frames in the partition
+	 */
+	static ReplacementPolicy *create(const ReplacementPolicyType type, BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+	virtual ~ReplacementPolicy() {}
+
+	/**
+	 * A page was read or allocated into the frame
+	 */
+	virtual void pageLoaded(const FrameId frame, const File *file, const PageId pageNo) = 0;
+
+	/**
+	 * The page held in the frame was found in the buffer pool
+	 */
+	virtual void pageAccessed(const FrameId frame) = 0;
+
+	/**
+	 * The frame was emptied by the buffer manager (the page was flushed out or disposed)
+	 */
+	virtual void frameFreed(const FrameId frame) = 0;
+
+	/**
+	 * Choose the frame to reuse. The policy stops tracking the chosen frame.
+	 *
+	 * @param frame	Frame returned in this, either empty or holding an unpinned page
+	 * @return false if every frame of the partition holds a pinned page
+	 */
+	virtual bool chooseVictim(FrameId &frame) = 0;
+
+ protected:
+	ReplacementPolicy(BufDesc *descsIn, const FrameId firstFrameIn, const std::uint32_t numFramesIn)
+		: descs(descsIn), firstFrame(firstFrameIn), numFrames(numFramesIn)
+	{
+	}
+
+	bool isValid(const FrameId frame) const { return descs[frame].valid; }
+	bool isPinned(const FrameId frame) const { return descs[frame].pinCnt > 0; }
+	bool isReferenced(const FrameId frame) const { return descs[frame].refbit; }
+	void clearReferenced(const FrameId frame) { descs[frame].refbit = false; }
+
+	BufDesc *descs;
+	FrameId firstFrame;
+	std::uint32_t numFrames;
+};
+
+
+/**
+* @brief The original clock sweep: a frame whose reference bit is set gets a second chance.
+*/
+class ClockPolicy : public ReplacementPolicy {
+ public:
+	ClockPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+	void pageLoaded(const FrameId frame, const File *file, const PageId pageNo);
+	void pageAccessed(const FrameId frame);
+	void frameFreed(const FrameId frame);
+	bool chooseVictim(FrameId &frame);
+
+ private:
+	/**
+	 * Current position of clockhand in our buffer pool
+	 */
+	FrameId clockHand;
+
+	/**
+	 * Advance clock to next frame in the partition
+	 */
+	void advanceClock()
+	{
+		clockHand = firstFrame + (clockHand - firstFrame + 1) % numFrames;
+	}
+};
+
+
+/**
+* @brief LRU-K: evicts the page whose K-th most recent access is the oldest.
+*
+* Pages referenced fewer than K times count as infinitely old and go first, least recently used
+* first, so pages touched once by a scan do not push out pages that are used again and again.
+*/
+class LRUKPolicy : public ReplacementPolicy {
+ public:
+	/**
+	 * Number of most recent accesses remembered per page
+	 */
+	static const int K = 2;
+
+	LRUKPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+	void pageLoaded(const FrameId frame, const File *file, const PageId pageNo);
+	void pageAccessed(const FrameId frame);
+	void frameFreed(const FrameId frame);
+	bool chooseVictim(FrameId &frame);
+
+ private:
+	/**
+	 * Logical time, advanced on every access
+	 */
+	std::uint64_t now;
+
+	/**
+	 * K most recent access times of the page in each frame, most recent first; 0 when unknown
+	 */
+	std::vector<std::uint64_t> history;
+
+	/**
+	 * Empty frames
+	 */
+	std::vector<FrameId> freeFrames;
+};
+
+
+/**
+* @brief 2Q: pages enter a FIFO queue (A1in) and only move to the LRU main queue (Am) when they are
+* referenced again after leaving A1in, which a ghost queue of recently evicted pages (A1out) detects.
+*
+* A sequential scan only cycles through A1in and leaves the pages in Am alone.
+*/
+class TwoQPolicy : public ReplacementPolicy {
+ public:
+	TwoQPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+	void pageLoaded(const FrameId frame, const File *file, const PageId pageNo);
+	void pageAccessed(const FrameId frame);
+	void frameFreed(const FrameId frame);
+	bool chooseVictim(FrameId &frame);
+
+ private:
+	typedef std::pair<const File *, PageId> PageKey;
+
+	enum Queue { NONE, A1IN, AM };
+
+	/**
+	 * Take the least recently queued unpinned frame of the queue
+	 */
+	bool takeFromQueue(std::list<FrameId> &queue, FrameId &frame);
+
+	/**
+	 * Remember the page held in the frame in A1out
+	 */
+	void addGhost(const FrameId frame);
+
+	/**
+	 * Maximum number of frames in A1in
+	 */
+	std::size_t kin;
+
+	/**
+	 * Maximum number of pages remembered in A1out
+	 */
+	std::size_t kout;
+
+	/**
+	 * A1in and Am, most recent at the front
+	 */
+	std::list<FrameId> a1in;
+	std::list<FrameId> am;
+
+	/**
+	 * A1out, most recent at the front, and an index over it
+	 */
+	std::list<PageKey> a1out;
+	std::map<PageKey, std::list<PageKey>::iterator> a1outIndex;
+
+	/**
+	 * Queue each frame is in, its position there and the page it holds
+	 */
+	std::vector<Queue> queueOf;
+	std::vector<std::list<FrameId>::iterator> position;
+	std::vector<PageKey> pageOf;
+
+	/**
+	 * Empty frames
+	 */
+	std::vector<FrameId> freeFrames;
+};
+
+}
@@ -7,8 +7,33 @@
 
 #pragma once
 
+#include <cstddef>
+#include <string>
+
 namespace badgerdb {
 
+/**
+ * @brief Datatype enumeration type.
+ */
+enum Datatype
+{
+	INTEGER = 0,
+	DOUBLE = 1,
+	STRING = 2
+};
+
+/**
+ * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() and
+ * FileScan::addFilter().
+ */
+enum Operator
+{ 
+	LT, 	/* Less Than */
+	LTE,	/* Less Than or Equal to */
+	GTE,	/* Greater Than or Equal to */
+	GT		/* Greater Than */
+};
+
 /**
  * @brief Identifier for a page in a file.
  */
@@ -59,4 +84,32 @@ struct RecordId {
   }
 };
 
+/**
+ * @brief Read-only view of the bytes of a record, pointing into the page that
+ * holds it.
+ *
+ * A view is only valid while that page stays where it is: for a page in the
+ * buffer pool, as long as it is pinned and the record is not changed.
+ */
+struct RecordView {
+  /**
+   * First byte of the record.
+   */
+  const char* data;
+
+  /**
+   * Number of bytes in the record.
+   */
+  std::size_t length;
+
+  /**
+   * Returns a copy of the record.
+   *
+   * @return  The record bytes.
+   */
+  std::string str() const {
+    return std::string(data, length);
+  }
+};
+
 }